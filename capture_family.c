@@ -0,0 +1,28 @@
+#include "hardware/pio.h"
+#include "pico/stdlib.h"
+#include "capture_family.h"
+
+// loads the program for format and sets up sm, pin is the jmp pin for rle
+// and the first input pin for raw. the choice is made here once so the
+// programs themselves stay branch free. false if there is no program for
+// the format, capture_format_find gives NULL for anything not generated
+bool capture_program_init(const capture_format *format, uint pin, PIO pio, uint sm, uint16_t clkdiv) {
+    if (format == NULL) return false;
+    const capture_program *prog = &capture_programs[format->id];
+    pio_sm_set_enabled(pio, sm, false);
+    uint offset = pio_add_program(pio, prog->program);
+    pio_sm_config c = prog->get_default_config(offset);
+    sm_config_set_clkdiv_int_frac(&c, clkdiv, 0);
+    // autopush, shift right puts the oldest unit in the low bits
+    sm_config_set_in_shift(&c, CAPTURE_UNITS_LSB_FIRST, true, 32);
+    if (format->encoding == CAPTURE_ENCODING_RLE) {
+        sm_config_set_jmp_pin(&c, pin);
+        sm_config_set_out_shift(&c, true, true, 32); // autopull enable shift right
+    } else {
+        sm_config_set_in_pins(&c, pin);
+        sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX); // nothing goes in, double the rx fifo
+    }
+
+    pio_sm_init(pio, sm, offset + prog->start, &c);
+    return true;
+}
@@ -0,0 +1,82 @@
+# generates one pio program per capture format from the .pio.in templates,
+# plus the format table (capture_formats.h) the firmware and host decoders
+# share and the matching program table (capture_programs.c).
+# formats are only listed here, add a width or channel count and rebuild.
+# host builds without the pico sdk only generate the format table.
+
+set(CAPTURE_RLE_COUNTER_BITS 4 8 16) # single pin run length, counter width
+set(CAPTURE_RAW_CHANNELS 1 2 4 8 16) # multi pin raw samples, pins per sample
+set(CAPTURE_FAMILY_DIR ${CMAKE_CURRENT_LIST_DIR})
+set(CAPTURE_GENERATED_DIR ${CMAKE_CURRENT_BINARY_DIR}/generated)
+
+function(capture_family_add_format TARGET TEMPLATE NAME ENTRY)
+    if (CAPTURE_FAMILY_PIO)
+        configure_file(${CAPTURE_FAMILY_DIR}/${TEMPLATE} ${CAPTURE_GENERATED_DIR}/${NAME}.pio @ONLY)
+        pico_generate_pio_header(${TARGET} ${CAPTURE_GENERATED_DIR}/${NAME}.pio OUTPUT_DIR ${CAPTURE_GENERATED_DIR})
+    endif()
+    set(CAPTURE_FORMAT_TABLE "${CAPTURE_FORMAT_TABLE}    ${ENTRY}, // ${NAME}\n" PARENT_SCOPE)
+    set(CAPTURE_PROGRAM_INCLUDES "${CAPTURE_PROGRAM_INCLUDES}#include \"${NAME}.pio.h\"\n" PARENT_SCOPE)
+    set(CAPTURE_PROGRAM_TABLE "${CAPTURE_PROGRAM_TABLE}    {&${NAME}_program, ${NAME}_offset_start, ${NAME}_program_get_default_config},\n" PARENT_SCOPE)
+endfunction()
+
+# how units of BITS bits (rle counters or raw samples) sit in the bytes the
+# dma writes: several to a byte from bit 0 up, or little endian over several
+# bytes. the programs shift right into the isr, that is what makes it so
+macro(capture_family_units BITS)
+    if (${BITS} LESS 8)
+        math(EXPR units_per_byte "8 / ${BITS}")
+        set(unit_bytes 1)
+    else()
+        set(units_per_byte 1)
+        math(EXPR unit_bytes "${BITS} / 8")
+    endif()
+endmacro()
+
+# fills the table variables in the calling function, with the pio programs
+# when CAPTURE_FAMILY_PIO is set
+macro(capture_family_tables TARGET)
+    set(CAPTURE_FORMAT_TABLE "")
+    set(CAPTURE_PROGRAM_INCLUDES "")
+    set(CAPTURE_PROGRAM_TABLE "")
+    set(CAPTURE_FORMAT_COUNT 0)
+    set(CAPTURE_UNITS_LSB_FIRST 1)
+
+    foreach(COUNTER_BITS ${CAPTURE_RLE_COUNTER_BITS})
+        # counters count down from all ones minus one, the setter dma feeds
+        # that value repeated across a whole word
+        math(EXPR counter_start "(1 << ${COUNTER_BITS}) - 2")
+        set(payload 0)
+        math(EXPR units "32 / ${COUNTER_BITS}")
+        foreach(unit RANGE 1 ${units})
+            math(EXPR payload "(${payload} << ${COUNTER_BITS}) | ${counter_start}" OUTPUT_FORMAT HEXADECIMAL)
+        endforeach()
+        capture_family_units(${COUNTER_BITS})
+        capture_family_add_format(${TARGET} pinpoller_rle.pio.in pinpoller_rle_w${COUNTER_BITS}
+            "{${CAPTURE_FORMAT_COUNT}, CAPTURE_ENCODING_RLE, 1, ${COUNTER_BITS}, ${units_per_byte}, ${unit_bytes}, ${counter_start}, ${payload}}")
+        math(EXPR CAPTURE_FORMAT_COUNT "${CAPTURE_FORMAT_COUNT} + 1")
+    endforeach()
+
+    foreach(CHANNELS ${CAPTURE_RAW_CHANNELS})
+        capture_family_units(${CHANNELS})
+        capture_family_add_format(${TARGET} pinsampler.pio.in pinsampler_c${CHANNELS}
+            "{${CAPTURE_FORMAT_COUNT}, CAPTURE_ENCODING_RAW, ${CHANNELS}, 0, ${units_per_byte}, ${unit_bytes}, 0, 0}")
+        math(EXPR CAPTURE_FORMAT_COUNT "${CAPTURE_FORMAT_COUNT} + 1")
+    endforeach()
+endmacro()
+
+function(capture_family_generate TARGET)
+    set(CAPTURE_FAMILY_PIO TRUE)
+    capture_family_tables(${TARGET})
+    configure_file(${CAPTURE_FAMILY_DIR}/capture_formats.h.in ${CAPTURE_GENERATED_DIR}/capture_formats.h @ONLY)
+    configure_file(${CAPTURE_FAMILY_DIR}/capture_programs.c.in ${CAPTURE_GENERATED_DIR}/capture_programs.c @ONLY)
+    target_sources(${TARGET} PRIVATE ${CAPTURE_GENERATED_DIR}/capture_programs.c)
+    target_include_directories(${TARGET} PUBLIC ${CAPTURE_FAMILY_DIR} ${CAPTURE_GENERATED_DIR})
+endfunction()
+
+# capture_formats.h only, for the host build
+function(capture_family_generate_formats TARGET)
+    set(CAPTURE_FAMILY_PIO FALSE)
+    capture_family_tables(${TARGET})
+    configure_file(${CAPTURE_FAMILY_DIR}/capture_formats.h.in ${CAPTURE_GENERATED_DIR}/capture_formats.h @ONLY)
+    target_include_directories(${TARGET} PUBLIC ${CAPTURE_FAMILY_DIR} ${CAPTURE_GENERATED_DIR})
+endfunction()
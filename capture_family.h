@@ -0,0 +1,15 @@
+#pragma once
+
+#include "hardware/pio.h"
+#include "capture_formats.h"
+
+// pio side of the generated capture formats, see capture_family.cmake
+typedef struct {
+    const pio_program_t *program;
+    uint start; // offset of the public start label
+    pio_sm_config (*get_default_config)(uint offset);
+} capture_program;
+
+extern const capture_program capture_programs[CAPTURE_FORMAT_COUNT];
+
+bool capture_program_init(const capture_format *format, uint pin, PIO pio, uint sm, uint16_t clkdiv);
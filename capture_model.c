@@ -0,0 +1,77 @@
+#include <string.h>
+
+#include "capture_model.h"
+
+void capture_model_init(capture_model *m, const capture_format *format, uint64_t rate_hz,
+    capture_model_block_func on_block, void *ctx) {
+    m->format = format;
+    m->rate_hz = rate_hz;
+    m->time_ns = 0;
+    m->samples = 0;
+    m->level = 0; // pinpoller starts in the low loop
+    m->run = 0;
+    m->bit = 0;
+    memset(m->block, 0, sizeof(m->block));
+    m->on_block = on_block;
+    m->ctx = ctx;
+}
+
+static void capture_model_emit(capture_model *m) {
+    m->on_block(m->block, (m->bit + 7) / 8, m->ctx);
+    memset(m->block, 0, sizeof(m->block));
+    m->bit = 0;
+}
+
+// appends a unit the way autopush with shift right packs them, oldest in the
+// low bits. widths divide the block so a unit never spans two blocks
+static void capture_model_put(capture_model *m, uint32_t value, uint8_t width) {
+    for (uint8_t done = 0; done < width; done += 8) {
+        m->block[(m->bit + done) >> 3] |= (uint8_t)((value >> done) << (m->bit & 7));
+    }
+    m->bit += width;
+    if (m->bit == CAPTURE_MODEL_BLOCK * 8) capture_model_emit(m);
+}
+
+// counters for one run, long runs saturate and get a zero run of the other level
+static void capture_model_run(capture_model *m, uint64_t samples) {
+    uint8_t width = m->format->counter_bits;
+    uint32_t saturated = (1u << width) - 1;
+    while (samples >= saturated) {
+        capture_model_put(m, saturated, width);
+        capture_model_put(m, m->format->counter_start, width);
+        samples -= saturated;
+    }
+    capture_model_put(m, m->format->counter_start - (uint32_t)samples, width);
+}
+
+void capture_model_feed(capture_model *m, uint8_t levels, uint32_t duration_ns) {
+    uint64_t end = m->time_ns + duration_ns;
+    uint64_t samples = ((end * m->rate_hz) / 1000000000u) - ((m->time_ns * m->rate_hz) / 1000000000u);
+    m->time_ns = end;
+    m->samples += samples;
+
+    if (m->format->encoding == CAPTURE_ENCODING_RLE) {
+        uint8_t level = levels & 1u;
+        if (samples == 0 || level == m->level) {
+            m->run += samples;
+            return;
+        }
+        capture_model_run(m, m->run);
+        m->level = level;
+        m->run = samples;
+        return;
+    }
+
+    uint8_t channels = m->format->channels;
+    uint32_t value = levels & ((1u << channels) - 1);
+    for (uint64_t i = 0; i < samples; i++) capture_model_put(m, value, channels);
+}
+
+// sends the current run and whatever is left in the block
+void capture_model_flush(capture_model *m) {
+    if (m->format->encoding == CAPTURE_ENCODING_RLE) {
+        capture_model_run(m, m->run);
+        m->run = 0;
+    }
+    if (m->bit) capture_model_emit(m);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "capture_formats.h"
+
+// c model of the generated capture programs, turns a waveform into the bytes
+// the dma would write for a capture format. plain C so the benchmark and host
+// tools can push synthetic signals through the same encoding the pio does.
+// it matches the data layout, not the pio timing around edges.
+
+#define CAPTURE_MODEL_BLOCK 2048 // bytes per block, same as one dma half in main.c
+
+typedef void (*capture_model_block_func)(const uint8_t *data, uint32_t len, void *ctx);
+
+typedef struct {
+    const capture_format *format;
+    uint64_t rate_hz; // samples per second
+    uint64_t time_ns; // signal time fed so far
+    uint64_t samples; // samples taken so far
+    uint8_t level; // rle, level of the current run
+    uint64_t run; // rle, samples in the current run
+    uint32_t bit; // bits used in block
+    uint8_t block[CAPTURE_MODEL_BLOCK];
+    capture_model_block_func on_block;
+    void *ctx;
+} capture_model;
+
+void capture_model_init(capture_model *m, const capture_format *format, uint64_t rate_hz,
+    capture_model_block_func on_block, void *ctx);
+void capture_model_feed(capture_model *m, uint8_t levels, uint32_t duration_ns);
+void capture_model_flush(capture_model *m);
@@ -0,0 +1,29 @@
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "capturebench_core.h"
+#include "stats.h"
+#include <stdio.h>
+
+// throughput and compression benchmark, the cases are in capturebench_core.c.
+// results are printed over uart as csv, one line per case, so runs can be
+// diffed. build with -DBUILD_CAPTURE_BENCH=ON. decode_bytes_per_s here is the
+// device figure, host/capturebench.c runs the same cases and times the
+// decoders where the host tools run them
+
+static void bench_print(const char *line) {
+    printf("%s\n", line);
+}
+
+int main() {
+    stdio_init_all();
+    stats_init();
+    sleep_ms(2000); // time to open the uart
+
+    // decodes are timed in processor cycles
+    capturebench_platform platform = {stats_cycles, stats_cycles_elapsed, clock_get_hz(clk_sys), bench_print};
+    printf("# capturebench seed 0x%08x signal %u ms clk_sys %lu\n", CAPTUREBENCH_SEED, CAPTUREBENCH_SIGNAL_MS,
+        clock_get_hz(clk_sys));
+    capturebench_run(&platform, CAPTUREBENCH_SIGNAL_MS);
+
+    while (1) tight_loop_contents();
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+
+#include "capturebench_core.h"
+#include "capture_formats.h"
+#include "capture_model.h"
+#include "signal_corpus.h"
+#include "rle_stream.h"
+#include "codec.h"
+#include "stream_format.h"
+
+// every corpus signal goes through the c model of every generated capture
+// format at every bench rate, then through the decoder the host uses
+// (rle_stream for rle, codec for raw blocks)
+
+#define USB_FS_BULK_BYTES_PER_S 1216000 // 19 bulk packets of 64 bytes per 1 ms frame
+#define LINE_LEN 160
+
+static const uint32_t bench_rates_hz[] = {1000000, 10000000, 31250000, 62500000};
+
+typedef struct {
+    const capturebench_platform *platform;
+    const capture_format *format;
+    rle_decoder dec;
+    uint64_t raw_bytes; // samples of all channels packed into bits
+    uint64_t encoded_bytes; // what goes over ep2, stream and codec headers included
+    uint64_t decode_bytes; // encoded bytes the decoder went through
+    uint64_t decode_ticks;
+    uint64_t high; // samples the decoder saw high, keeps the decode from being dropped
+} bench_case;
+
+static uint8_t codec_out[CAPTURE_MODEL_BLOCK];
+static uint8_t codec_scratch[CAPTURE_MODEL_BLOCK];
+static uint8_t decoded[CAPTURE_MODEL_BLOCK];
+static capture_model model;
+
+static void bench_run_sink(uint8_t level, uint32_t samples, void *ctx) {
+    uint64_t *high = ctx;
+    if (level) *high += samples;
+}
+
+static void bench_block(const uint8_t *data, uint32_t len, void *ctx) {
+    bench_case *c = ctx;
+    const capturebench_platform *platform = c->platform;
+    uint32_t start;
+    c->encoded_bytes += sizeof(stream_block_header);
+    if (c->format->encoding == CAPTURE_ENCODING_RLE) {
+        // rle blocks go out as they are, like stream mode
+        c->encoded_bytes += len;
+        start = platform->clock_now();
+        rle_decoder_feed(&c->dec, data, len, bench_run_sink, &c->high);
+        c->decode_ticks += platform->clock_elapsed(start);
+        c->decode_bytes += len;
+        return;
+    }
+
+    // raw blocks get a codec picked per block, like multi mode
+    uint32_t out_len;
+    codec_type codec = codec_encode_block(data, len, codec_out, codec_scratch, &out_len, NULL, NULL);
+    c->encoded_bytes += sizeof(codec_block_header) + out_len;
+    start = platform->clock_now();
+    codec_decode_block(codec, codec_out, out_len, decoded, sizeof(decoded));
+    c->decode_ticks += platform->clock_elapsed(start);
+    c->decode_bytes += out_len;
+}
+
+static void bench_case_run(const capturebench_platform *platform, signal_kind kind, const capture_format *format,
+    uint32_t rate_hz, uint32_t signal_ms) {
+    bench_case c = {.platform = platform, .format = format};
+    if (format->encoding == CAPTURE_ENCODING_RLE) rle_decoder_init_width(&c.dec, format->counter_bits);
+    capture_model_init(&model, format, rate_hz, bench_block, &c);
+
+    signal_gen gen;
+    signal_corpus_init(&gen, kind, CAPTUREBENCH_SEED);
+    uint64_t end_ns = signal_ms * 1000000ull;
+    while (model.time_ns < end_ns) {
+        signal_segment seg;
+        signal_corpus_next(&gen, &seg);
+        if (model.time_ns + seg.duration_ns > end_ns) seg.duration_ns = end_ns - model.time_ns;
+        capture_model_feed(&model, seg.levels, seg.duration_ns);
+    }
+    capture_model_flush(&model);
+
+    c.raw_bytes = (model.samples * format->channels + 7) / 8;
+    double seconds = signal_ms / 1000.0;
+    double encoded_per_s = c.encoded_bytes / seconds;
+    double decode_s = (double)c.decode_ticks / platform->ticks_per_s;
+    char line[LINE_LEN];
+    snprintf(line, sizeof(line), "%s,%u,%s,%u,%u,%lu,%llu,%llu,%llu,%.3f,%.0f,%.2f,%.0f",
+        signal_corpus_name(kind), format->id,
+        format->encoding == CAPTURE_ENCODING_RLE ? "rle" : "raw",
+        format->channels, format->counter_bits, (unsigned long)rate_hz,
+        (unsigned long long)model.samples, (unsigned long long)c.raw_bytes, (unsigned long long)c.encoded_bytes,
+        (double)c.raw_bytes / c.encoded_bytes, encoded_per_s,
+        (encoded_per_s * 100.0) / USB_FS_BULK_BYTES_PER_S,
+        decode_s > 0 ? c.decode_bytes / decode_s : 0.0);
+    platform->print(line);
+}
+
+void capturebench_run(const capturebench_platform *platform, uint32_t signal_ms) {
+    platform->print("signal,format,encoding,channels,counter_bits,sample_rate_hz,samples,raw_bytes,encoded_bytes,"
+        "ratio,encoded_bytes_per_s,usb_load_pct,decode_bytes_per_s");
+    for (int kind = 0; kind < SIGNAL_COUNT; kind++) {
+        for (int f = 0; f < CAPTURE_FORMAT_COUNT; f++) {
+            for (uint32_t r = 0; r < sizeof(bench_rates_hz) / sizeof(bench_rates_hz[0]); r++) {
+                bench_case_run(platform, kind, &capture_formats[f], bench_rates_hz[r], signal_ms);
+            }
+        }
+    }
+    platform->print("# done");
+}
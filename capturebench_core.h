@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// the cases of capturebench.c and host/capturebench.c. plain C like
+// capture_model.c so both builds run the same signals, formats and rates and
+// print the same csv columns. the platform brings the clock the decoders are
+// timed with and somewhere for the lines to go.
+
+#define CAPTUREBENCH_SEED 0x1a2b3c4d // change it and old results are no longer comparable
+#define CAPTUREBENCH_SIGNAL_MS 20
+
+typedef struct {
+    uint32_t (*clock_now)(void);
+    uint32_t (*clock_elapsed)(uint32_t start); // ticks since a clock_now reading
+    uint32_t ticks_per_s;
+    void (*print)(const char *line); // one line of output, without the newline
+} capturebench_platform;
+
+// prints the csv column line, one line per case and "# done"
+void capturebench_run(const capturebench_platform *platform, uint32_t signal_ms);
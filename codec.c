@@ -0,0 +1,89 @@
+#include <string.h>
+#include <stdbool.h>
+
+#include "codec.h"
+
+#define CODEC_MAX_REPEATS 255 // repeats fit in one byte
+
+static inline uint8_t codec_symbol(const uint8_t *in, uint32_t i, bool xor) {
+    if (!xor) return in[i];
+    return in[i] ^ ((i == 0) ? 0 : in[i - 1]);
+}
+
+// gives up and returns 0 once the output would go past limit, so a codec that
+// cant win stops early. that keeps a block at two passes over the input at most.
+// also gives up, setting expired, when the budget says the time is up
+static uint32_t codec_rle_encode(const uint8_t *in, uint32_t len, uint8_t *out, uint32_t limit, bool xor,
+    codec_budget_func budget, void *ctx, bool *expired) {
+    uint32_t o = 0;
+    uint32_t i = 0;
+    uint32_t next_check = CODEC_BUDGET_STRIDE;
+    while (i < len) {
+        if (budget != NULL && i >= next_check) {
+            next_check = i + CODEC_BUDGET_STRIDE;
+            if (!budget(ctx)) {
+                *expired = true;
+                return 0;
+            }
+        }
+        uint8_t symbol = codec_symbol(in, i, xor);
+        uint32_t repeats = 0;
+        while ((i + repeats + 1) < len && repeats < CODEC_MAX_REPEATS
+               && codec_symbol(in, i + repeats + 1, xor) == symbol) {
+            repeats++;
+        }
+        if (o + 2 > limit) return 0;
+        out[o++] = symbol;
+        out[o++] = repeats;
+        i += repeats + 1;
+    }
+    return o;
+}
+
+// picks the smallest of raw, rle and xor rle. scratch needs len bytes. budget
+// can be NULL, otherwise the block goes out with the best codec finished by
+// the time it says stop, raw if none
+codec_type codec_encode_block(const uint8_t *in, uint32_t len, uint8_t *out, uint8_t *scratch, uint32_t *out_len,
+    codec_budget_func budget, void *ctx) {
+    codec_type codec = CODEC_RAW;
+    uint32_t best = len;
+    bool expired = false;
+
+    uint32_t n = codec_rle_encode(in, len, out, best - 1, false, budget, ctx, &expired);
+    if (n) {
+        codec = CODEC_RLE;
+        best = n;
+    }
+    if (!expired) n = codec_rle_encode(in, len, scratch, best - 1, true, budget, ctx, &expired);
+    if (!expired && n) {
+        codec = CODEC_XOR_RLE;
+        best = n;
+        memcpy(out, scratch, n);
+    }
+    if (codec == CODEC_RAW) memcpy(out, in, len);
+    *out_len = best;
+    return codec;
+}
+
+// returns the number of bytes written to out
+uint32_t codec_decode_block(uint8_t codec, const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_max) {
+    if (codec == CODEC_RAW) {
+        uint32_t n = (in_len < out_max) ? in_len : out_max;
+        memcpy(out, in, n);
+        return n;
+    }
+    if (codec != CODEC_RLE && codec != CODEC_XOR_RLE) return 0;
+
+    bool xor = (codec == CODEC_XOR_RLE);
+    uint32_t o = 0;
+    uint8_t prev = 0;
+    for (uint32_t i = 0; (i + 1) < in_len; i += 2) {
+        for (uint32_t r = 0; r <= in[i + 1]; r++) {
+            if (o >= out_max) return o;
+            uint8_t sample = xor ? (in[i] ^ prev) : in[i];
+            out[o++] = sample;
+            prev = sample;
+        }
+    }
+    return o;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// per block codecs for multi pin samples packed into bytes (one byte per sample
+// at 8 channels, the codecs only see bytes). plain C with
+// no sdk headers so the host decodes with the same code the device encodes with.
+// every block decodes on its own, nothing carries over between blocks.
+
+typedef enum {
+    CODEC_RAW = 0,     // samples as they are
+    CODEC_RLE = 1,     // (sample, repeats) pairs, good for quiet lines
+    CODEC_XOR_RLE = 2, // rle of every sample xor the one before, good for busy clocks
+    CODEC_COUNT,
+} codec_type;
+
+// in front of the encoded bytes of every block. the codecs work on bytes, so
+// the block length is in bytes too, samples are channels bits each in them
+typedef struct {
+    uint8_t codec; // codec_type
+    uint8_t channels; // pins in every sample
+    uint16_t bytes; // bytes after decoding, what codec_decode_block returns
+} __attribute__((packed)) codec_block_header;
+
+// asked every CODEC_BUDGET_STRIDE input bytes while a codec is tried,
+// returning false stops compressing the block
+typedef bool (*codec_budget_func)(void *ctx);
+
+#define CODEC_BUDGET_STRIDE 256
+
+codec_type codec_encode_block(const uint8_t *in, uint32_t len, uint8_t *out, uint8_t *scratch, uint32_t *out_len,
+    codec_budget_func budget, void *ctx);
+uint32_t codec_decode_block(uint8_t codec, const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_max);
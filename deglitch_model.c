@@ -0,0 +1,117 @@
+#include "deglitch_model.h"
+
+// instructions in program order
+enum {
+    START, // pull block
+    INIT_X, // mov x ~null
+    INIT_PINS, // set pins 0
+    INIT_JMP, // jmp low_wait
+    LOW_GLITCH, // jmp x-- low_wait
+    LOW_WAIT, // jmp pin low_edge, also the whole wrap loop
+    LOW_EDGE, // mov y osr
+    LOW_CONFIRM, // jmp pin low_still_high
+    LOW_CONFIRM_FAIL, // jmp low_glitch
+    LOW_STILL_HIGH, // jmp y-- low_confirm
+    LOW_PASS, // set pins 1
+    HIGH_WAIT, // jmp pin high_wait
+    HIGH_EDGE, // mov y osr
+    HIGH_CONFIRM, // jmp pin high_glitch
+    HIGH_STILL_LOW, // jmp y-- high_confirm
+    HIGH_PASS, // set pins 0
+    HIGH_DONE, // jmp low_wait
+    HIGH_GLITCH, // jmp x-- high_wait
+    HIGH_GLITCH_JMP, // jmp high_wait
+};
+
+// the sm is set up and has threshold - 2 waiting in the tx fifo, the first
+// step runs the pull
+void deglitch_model_init(deglitch_model *m, uint32_t threshold) {
+    m->pc = START;
+    m->osr = threshold - 2;
+    m->x = 0;
+    m->y = 0;
+    m->out = 0;
+}
+
+// jmp x-- and jmp y-- test before they decrement
+static bool deglitch_model_dec(uint32_t *reg) {
+    return (*reg)-- != 0;
+}
+
+// one pio cycle with pin as the jmp pin level in it, returns the set pin
+// level after the cycle
+uint8_t deglitch_model_step(deglitch_model *m, uint8_t pin) {
+    switch (m->pc) {
+    case START:
+        m->pc = INIT_X;
+        break;
+    case INIT_X:
+        m->x = UINT32_MAX;
+        m->pc = INIT_PINS;
+        break;
+    case INIT_PINS:
+        m->out = 0;
+        m->pc = INIT_JMP;
+        break;
+    case INIT_JMP:
+        m->pc = LOW_WAIT;
+        break;
+    case LOW_GLITCH:
+        // falls into low_wait when x runs out as well
+        deglitch_model_dec(&m->x);
+        m->pc = LOW_WAIT;
+        break;
+    case LOW_WAIT:
+        m->pc = pin ? LOW_EDGE : LOW_WAIT;
+        break;
+    case LOW_EDGE:
+        m->y = m->osr;
+        m->pc = LOW_CONFIRM;
+        break;
+    case LOW_CONFIRM:
+        m->pc = pin ? LOW_STILL_HIGH : LOW_CONFIRM_FAIL;
+        break;
+    case LOW_CONFIRM_FAIL:
+        m->pc = LOW_GLITCH;
+        break;
+    case LOW_STILL_HIGH:
+        m->pc = deglitch_model_dec(&m->y) ? LOW_CONFIRM : LOW_PASS;
+        break;
+    case LOW_PASS:
+        m->out = 1;
+        m->pc = HIGH_WAIT;
+        break;
+    case HIGH_WAIT:
+        m->pc = pin ? HIGH_WAIT : HIGH_EDGE;
+        break;
+    case HIGH_EDGE:
+        m->y = m->osr;
+        m->pc = HIGH_CONFIRM;
+        break;
+    case HIGH_CONFIRM:
+        m->pc = pin ? HIGH_GLITCH : HIGH_STILL_LOW;
+        break;
+    case HIGH_STILL_LOW:
+        m->pc = deglitch_model_dec(&m->y) ? HIGH_CONFIRM : HIGH_PASS;
+        break;
+    case HIGH_PASS:
+        m->out = 0;
+        m->pc = HIGH_DONE;
+        break;
+    case HIGH_DONE:
+        m->pc = LOW_WAIT;
+        break;
+    case HIGH_GLITCH:
+        m->pc = deglitch_model_dec(&m->x) ? HIGH_WAIT : HIGH_GLITCH_JMP;
+        break;
+    case HIGH_GLITCH_JMP:
+        m->pc = HIGH_WAIT;
+        break;
+    }
+    return m->out;
+}
+
+// what deglitch_filter_glitches reads back
+uint32_t deglitch_model_glitches(const deglitch_model *m) {
+    return ~m->x;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// c model of the deglitch program in pinpoller.pio, one instruction per pio
+// cycle with the same labels. plain C so the host can check the filter
+// timing without a board. unlike capture_model this one is cycle exact, keep
+// it in step with the program.
+
+typedef struct {
+    uint8_t pc; // next instruction, see deglitch_model.c
+    uint32_t osr; // threshold - 2, as deglitch_filter_init puts it
+    uint32_t x; // glitches, counting down from all ones
+    uint32_t y;
+    uint8_t out; // level on the set pin
+} deglitch_model;
+
+void deglitch_model_init(deglitch_model *m, uint32_t threshold);
+uint8_t deglitch_model_step(deglitch_model *m, uint8_t pin);
+uint32_t deglitch_model_glitches(const deglitch_model *m);
@@ -1,40 +1,49 @@
 #include "pico/stdlib.h"
 #include "hardware/dma.h"
 #include "hardware/pio.h"
+#include "hardware/irq.h"
 #include "pinpoller.h"
+#include "sched.h"
+#include "hot_path.h"
 
 #define PIO1_DREQ_OFFSET 8
+#define CRC32_SEED 0xffffffff
 
-int initial_dma_settings(dma_channel_config *c, bool rx, poller_program prog) {
+int initial_dma_settings(dma_channel_config *c, bool rx, PIO pio, uint sm) {
     int channel = dma_claim_unused_channel(true);
     dma_channel_config cfg = dma_channel_get_default_config(channel);
     channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
     uint dreq = (rx) ? DREQ_PIO0_RX0 : DREQ_PIO0_TX0;
-    dreq += prog.sm;
-    if (prog.pio == pio1) dreq += PIO1_DREQ_OFFSET;
+    dreq += sm;
+    if (pio == pio1) dreq += PIO1_DREQ_OFFSET;
     channel_config_set_dreq(&cfg, dreq);
     *c = cfg;
     return channel;
 }
 
-int init_getter_dma(uint32_t *destination, uint destination_length, poller_program prog) {
+int init_getter_dma_sm(uint32_t *destination, uint destination_length, PIO pio, uint sm) {
     dma_channel_config c;
-    int channel = initial_dma_settings(&c ,true, prog);
+    int channel = initial_dma_settings(&c ,true, pio, sm);
     channel_config_set_read_increment(&c, false);
     channel_config_set_write_increment(&c, true);
+    channel_config_set_sniff_enable(&c, true); // only counts once init_getter_crc picks this channel
     dma_channel_configure(
         channel,
         &c,
         destination,
-        &prog.pio->rxf[prog.sm],
+        &pio->rxf[sm],
         destination_length,
         false);
     return channel;
 }
 
+int init_getter_dma(uint32_t *destination, uint destination_length, poller_program prog) {
+    return init_getter_dma_sm(destination, destination_length, prog.pio, prog.sm);
+}
+
 int init_setter_dma(uint32_t *payload, poller_program prog) {
     dma_channel_config c;
-    int channel = initial_dma_settings(&c, false, prog);
+    int channel = initial_dma_settings(&c, false, prog.pio, prog.sm);
     channel_config_set_read_increment(&c, false);
     channel_config_set_write_increment(&c, false);
     dma_channel_configure(
@@ -45,4 +54,38 @@ int init_setter_dma(uint32_t *payload, poller_program prog) {
         UINT32_MAX,
         true);
     return channel;
-}
\ No newline at end of file
+}
+
+// the sniffer computes a crc32 of everything the getter writes, no cpu involved.
+// crc32r with reversed and inverted output is the usual zlib crc32 of the
+// bytes in memory order
+void init_getter_crc(int channel) {
+    dma_sniffer_enable(channel, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    dma_sniffer_set_output_reverse_enabled(true);
+    dma_sniffer_set_output_invert_enabled(true);
+    dma_sniffer_set_data_accumulator(CRC32_SEED);
+}
+
+// crc of the getter writes since the last call, call it between the end of a
+// block and the restart of the getter
+uint32_t take_getter_crc(void) {
+    uint32_t crc = dma_sniffer_get_data_accumulator();
+    dma_sniffer_set_data_accumulator(CRC32_SEED);
+    return crc;
+}
+
+static uint32_t getter_irq_mask = 0;
+
+static void HOT_PATH_FUNC(getter_irq)(void) {
+    uint32_t done = dma_hw->ints0 & getter_irq_mask;
+    dma_hw->ints0 = done;
+    if (done) sched_post(SCHED_EVENT_CAPTURE_BLOCK);
+}
+
+// the getter posts SCHED_EVENT_CAPTURE_BLOCK every time it finishes a block
+void init_getter_irq(int channel) {
+    getter_irq_mask |= 1u << channel;
+    dma_channel_set_irq0_enabled(channel, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, getter_irq);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
@@ -1,4 +1,8 @@
 #pragma once
 
+int init_getter_dma_sm(uint32_t *destination, uint destination_length, PIO pio, uint sm);
 int init_getter_dma(uint32_t *destination, uint destination_length, poller_program prog);
-int init_setter_dma(uint32_t *payload, poller_program prog);
\ No newline at end of file
+int init_setter_dma(uint32_t *payload, poller_program prog);
+void init_getter_crc(int channel);
+uint32_t take_getter_crc(void);
+void init_getter_irq(int channel);
\ No newline at end of file
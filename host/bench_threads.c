@@ -0,0 +1,29 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "bench_threads.h"
+
+typedef struct {
+    pthread_t thread;
+    bench_thread_func func;
+    void *arg;
+} bench_thread;
+
+static void *bench_thread_main(void *arg) {
+    bench_thread *t = arg;
+    t->func(t->arg);
+    return NULL;
+}
+
+void bench_threads_run(unsigned threads, bench_thread_func func, void *args, size_t arg_size) {
+    bench_thread *t = calloc(threads, sizeof(bench_thread));
+    assert(t != NULL);
+    for (unsigned i = 1; i < threads; i++) {
+        t[i] = (bench_thread){.func = func, .arg = (char *)args + (i * arg_size)};
+        assert(pthread_create(&t[i].thread, NULL, bench_thread_main, &t[i]) == 0);
+    }
+    func(args);
+    for (unsigned i = 1; i < threads; i++) assert(pthread_join(t[i].thread, NULL) == 0);
+    free(t);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+
+// runs func once per thread for the host benchmarks, args is an array of
+// threads elements of arg_size bytes and thread n gets element n. the caller
+// is thread 0 and it returns once all of them are done.
+//
+// pthread.h pulls in the system sched.h, built on its own so the firmware's
+// sched.h on the include path of the benchmarks does not shadow it
+
+typedef void (*bench_thread_func)(void *arg);
+
+void bench_threads_run(unsigned threads, bench_thread_func func, void *args, size_t arg_size);
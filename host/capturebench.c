@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "capturebench_core.h"
+
+// host side of capturebench.c: the same cases from capturebench_core.c with
+// the decoders timed on the machine that runs them for real.
+// decode_bytes_per_s here is the number the host tools get, the firmware
+// build of capturebench.c stays as the device side data point. the signal
+// length in ms can be given as the only argument
+
+static uint32_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    // a single decode is far shorter than the 4 s this wraps at
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000u) + ts.tv_nsec);
+}
+
+static uint32_t bench_elapsed_ns(uint32_t start) {
+    return bench_now_ns() - start;
+}
+
+static void bench_print(const char *line) {
+    printf("%s\n", line);
+}
+
+int main(int argc, char **argv) {
+    uint32_t signal_ms = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : CAPTUREBENCH_SIGNAL_MS;
+    if (signal_ms == 0) signal_ms = CAPTUREBENCH_SIGNAL_MS;
+
+    static const capturebench_platform platform = {bench_now_ns, bench_elapsed_ns, 1000000000u, bench_print};
+    printf("# capturebench host seed 0x%08x signal %u ms\n", CAPTUREBENCH_SEED, signal_ms);
+    capturebench_run(&platform, signal_ms);
+    return 0;
+}
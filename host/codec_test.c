@@ -0,0 +1,60 @@
+#include <assert.h>
+#include <string.h>
+
+#include "codec.h"
+
+// a quiet block compresses, a block whose budget runs out goes out with
+// what was done, and every block decodes back to the bytes it came from
+
+#define BLOCK 2048
+
+static uint32_t checks = 0;
+
+static bool never(void *ctx) {
+    (void)ctx;
+    checks++;
+    return false;
+}
+
+// lets the first codec finish, then stops
+static bool once_through(void *ctx) {
+    uint32_t *left = ctx;
+    checks++;
+    if (*left == 0) return false;
+    (*left)--;
+    return true;
+}
+
+static void roundtrip(const uint8_t *in, const uint8_t *out, uint32_t out_len, codec_type codec) {
+    static uint8_t decoded[BLOCK];
+    codec_block_header header = {codec, 8, BLOCK};
+    uint32_t n = codec_decode_block(header.codec, out, out_len, decoded, header.bytes);
+    assert(n == header.bytes);
+    assert(memcmp(decoded, in, BLOCK) == 0);
+}
+
+int main(void) {
+    static uint8_t in[BLOCK], out[BLOCK], scratch[BLOCK];
+    uint32_t out_len;
+    // a slow square wave on every pin, long runs of the same byte
+    for (uint32_t i = 0; i < BLOCK; i++) in[i] = ((i / 600) & 1) ? 0xff : 0x00;
+
+    codec_type codec = codec_encode_block(in, BLOCK, out, scratch, &out_len, NULL, NULL);
+    assert(codec != CODEC_RAW && out_len < 32);
+    roundtrip(in, out, out_len, codec);
+
+    // no time at all, the block goes out raw
+    checks = 0;
+    codec = codec_encode_block(in, BLOCK, out, scratch, &out_len, never, NULL);
+    assert(checks == 1);
+    assert(codec == CODEC_RAW && out_len == BLOCK);
+    roundtrip(in, out, out_len, codec);
+
+    // time for rle but not for xor rle, rle is kept
+    uint32_t left = (BLOCK / CODEC_BUDGET_STRIDE) - 1;
+    codec = codec_encode_block(in, BLOCK, out, scratch, &out_len, once_through, &left);
+    assert(left == 0);
+    assert(codec == CODEC_RLE);
+    roundtrip(in, out, out_len, codec);
+    return 0;
+}
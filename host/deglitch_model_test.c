@@ -0,0 +1,80 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "deglitch_model.h"
+
+// pulses around the threshold through the deglitch program model. a sample
+// is 2 pio cycles (the pinpoller rate), so threshold - 1 samples is dropped
+// and counted, threshold and threshold + 1 samples pass. a passing pulse's
+// leading edge comes out 2 * threshold cycles late. the trailing edge is only
+// looked for once the leading one is out, so pulses shorter than that come
+// out stretched
+
+typedef struct {
+    deglitch_model m;
+    uint64_t cycle; // cycles run so far
+    uint8_t out;
+    uint64_t changes[2]; // cycle of the last set pins 0 and set pins 1
+    uint32_t changed; // output changes since the last check
+} bench;
+
+static void drive(bench *b, uint8_t pin, uint32_t cycles) {
+    for (uint32_t i = 0; i < cycles; i++) {
+        uint8_t out = deglitch_model_step(&b->m, pin);
+        if (out != b->out) {
+            b->changes[out] = b->cycle;
+            b->changed++;
+            b->out = out;
+        }
+        b->cycle++;
+    }
+}
+
+// a pulse of width cycles away from level, then back long enough for the
+// filter to settle
+static void pulse(bench *b, uint32_t threshold, uint8_t level, uint32_t width) {
+    uint64_t start = b->cycle;
+    uint32_t glitches = deglitch_model_glitches(&b->m);
+    b->changed = 0;
+    drive(b, !level, width);
+    uint64_t end = b->cycle;
+    drive(b, level, (4 * threshold) + 16);
+
+    uint64_t latency = 2 * threshold;
+    if (width <= latency - 2) {
+        assert(b->changed == 0);
+        assert(deglitch_model_glitches(&b->m) == glitches + 1);
+        return;
+    }
+    assert(b->changed == 2);
+    assert(deglitch_model_glitches(&b->m) == glitches);
+    assert(b->changes[!level] == start + latency);
+    // set pins and the jump back to low_wait after a falling edge are not looking
+    uint64_t blind = start + latency + (level ? 2 : 1);
+    uint64_t seen = (end > blind) ? end : blind;
+    assert(b->changes[level] == seen + latency);
+    printf("threshold %u, %s pulse of %u cycles: out after %u, %u cycles wide\n", threshold,
+           level ? "low" : "high", width, (unsigned)latency, (unsigned)(b->changes[level] - b->changes[!level]));
+}
+
+int main(void) {
+    static const uint32_t thresholds[] = {2, 3, 5, 8};
+    for (uint32_t i = 0; i < sizeof(thresholds) / sizeof(thresholds[0]); i++) {
+        uint32_t t = thresholds[i];
+        bench b = {0};
+        deglitch_model_init(&b.m, t);
+        drive(&b, 0, 16);
+        assert(b.out == 0 && deglitch_model_glitches(&b.m) == 0);
+
+        // threshold - 1, threshold and threshold + 1 samples, the cycle either
+        // side of the drop limit and a long pulse
+        uint32_t widths[] = {2 * (t - 1), 2 * t, 2 * (t + 1), (2 * t) - 1, (4 * t) + 5};
+        for (uint32_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) pulse(&b, t, 0, widths[w]);
+
+        drive(&b, 1, (4 * t) + 16);
+        assert(b.out == 1);
+        for (uint32_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) pulse(&b, t, 1, widths[w]);
+        assert(deglitch_model_glitches(&b.m) == 2);
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture_model.h"
+#include "preview.h"
+#include "signal_corpus.h"
+
+// previews against buckets worked out sample by sample. rle captures from the
+// capture model are fed in blocks far shorter than their runs, so runs span
+// blocks and the unfinished run is counted before it ends. packed samples of
+// every channel count go in with buckets that do and do not line up with the
+// blocks, and a bucket of nothing but edges saturates its transition count
+
+#define FEED_BYTES 64
+#define RATE_HZ 1000000u
+#define SIGNAL_MS 200
+#define RAW_SAMPLES 20000
+#define MAX_RECORDS 16384
+
+static preview_record records[MAX_RECORDS];
+static uint32_t record_count;
+
+typedef struct {
+    uint16_t *values; // one per sample
+    uint32_t len;
+    uint32_t cap;
+} samples;
+
+static void on_record(const preview_record *rec, void *ctx) {
+    assert(record_count < MAX_RECORDS);
+    records[record_count++] = *rec;
+}
+
+static void push(samples *s, uint16_t value, uint32_t n) {
+    if (s->len + n > s->cap) {
+        s->cap = (s->cap * 2) + n;
+        s->values = realloc(s->values, s->cap * sizeof(uint16_t));
+        assert(s->values != NULL);
+    }
+    for (uint32_t i = 0; i < n; i++) s->values[s->len++] = value;
+}
+
+// every complete record has to match the buckets of s. raw blocks hold
+// block_samples samples each and give exact block numbers, rle ones only
+// have to move forward
+static void check_records(const samples *s, uint32_t bucket_samples, uint32_t block_samples) {
+    uint32_t record_samples = PREVIEW_BUCKETS * bucket_samples;
+    assert(record_count == s->len / record_samples);
+    uint32_t last_block = 0;
+    for (uint32_t r = 0; r < record_count; r++) {
+        const preview_record *rec = &records[r];
+        assert(rec->first_bucket == r * PREVIEW_BUCKETS);
+        assert(rec->bucket_samples == bucket_samples);
+        assert(rec->block_first <= rec->block_last && rec->block_first >= last_block);
+        last_block = rec->block_first;
+        if (block_samples) {
+            assert(rec->block_first == (r * record_samples) / block_samples);
+            assert(rec->block_last == ((r + 1) * record_samples - 1) / block_samples);
+        }
+        for (uint32_t b = 0; b < PREVIEW_BUCKETS; b++) {
+            preview_bucket expected = {0xffff, 0, 0};
+            uint32_t start = (r * PREVIEW_BUCKETS + b) * bucket_samples;
+            for (uint32_t i = start; i < start + bucket_samples; i++) {
+                expected.all_high &= s->values[i];
+                expected.any_high |= s->values[i];
+                if (i > 0 && s->values[i] != s->values[i - 1] && expected.transitions != 0xffff) expected.transitions++;
+            }
+            assert(memcmp(&rec->buckets[b], &expected, sizeof(expected)) == 0);
+        }
+    }
+}
+
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t cap;
+} rle_capture;
+
+static void on_model_block(const uint8_t *data, uint32_t len, void *ctx) {
+    rle_capture *c = ctx;
+    if (c->len + len > c->cap) {
+        c->cap = (c->cap * 2) + len;
+        c->data = realloc(c->data, c->cap);
+        assert(c->data != NULL);
+    }
+    memcpy(c->data + c->len, data, len);
+    c->len += len;
+}
+
+static void on_run(uint8_t level, uint32_t n, void *ctx) {
+    push(ctx, level, n);
+}
+
+static void check_rle(signal_kind kind, const capture_format *format, uint32_t bucket_samples) {
+    rle_capture c = {0};
+    capture_model model;
+    capture_model_init(&model, format, RATE_HZ, on_model_block, &c);
+    signal_gen gen;
+    signal_corpus_init(&gen, kind, 0);
+    while (model.time_ns < SIGNAL_MS * 1000000ull) {
+        signal_segment seg;
+        signal_corpus_next(&gen, &seg);
+        capture_model_feed(&model, seg.levels, seg.duration_ns);
+    }
+    capture_model_flush(&model);
+
+    // reference levels from one decode of the whole capture, the run still
+    // open at the end is in the preview too
+    samples s = {0};
+    rle_decoder dec;
+    assert(rle_decoder_init_width(&dec, format->counter_bits));
+    rle_decoder_feed(&dec, c.data, c.len, on_run, &s);
+    push(&s, dec.level, dec.run);
+
+    static preview p;
+    record_count = 0;
+    assert(preview_init(&p, bucket_samples, 1, format->counter_bits, on_record, NULL));
+    for (uint32_t at = 0; at < c.len; at += FEED_BYTES) {
+        uint32_t n = (c.len - at < FEED_BYTES) ? c.len - at : FEED_BYTES;
+        preview_feed(&p, at / FEED_BYTES, c.data + at, n);
+    }
+    printf("rle kind %d w%u buckets of %u: %u samples, %u records\n", kind, format->counter_bits, bucket_samples,
+           s.len, record_count);
+    assert(record_count > 0);
+    check_records(&s, bucket_samples, 0);
+    free(s.values);
+    free(c.data);
+}
+
+// packs s the way autopush leaves it, sample i at bit i * channels
+static uint8_t *pack(const samples *s, uint8_t channels, uint32_t *len) {
+    *len = (s->len * channels + 7) / 8;
+    uint8_t *data = calloc(*len, 1);
+    assert(data != NULL);
+    for (uint32_t i = 0; i < s->len; i++) {
+        uint32_t bit = i * channels;
+        if (channels == 16) {
+            data[bit >> 3] = s->values[i] & 0xff;
+            data[(bit >> 3) + 1] = s->values[i] >> 8;
+        } else {
+            data[bit >> 3] |= s->values[i] << (bit & 7);
+        }
+    }
+    return data;
+}
+
+static void check_raw(const samples *s, uint8_t channels, uint32_t bucket_samples) {
+    uint32_t len;
+    uint8_t *data = pack(s, channels, &len);
+    static preview p;
+    record_count = 0;
+    assert(preview_init(&p, bucket_samples, channels, 0, on_record, NULL));
+    for (uint32_t at = 0; at < len; at += FEED_BYTES) {
+        uint32_t n = (len - at < FEED_BYTES) ? len - at : FEED_BYTES;
+        preview_feed(&p, at / FEED_BYTES, data + at, n);
+    }
+    printf("raw %u channels buckets of %u: %u samples, %u records\n", channels, bucket_samples, s->len, record_count);
+    check_records(s, bucket_samples, (FEED_BYTES * 8) / channels);
+    free(data);
+}
+
+int main(void) {
+    // short and long runs, the long ones saturate the counters
+    static const signal_kind kinds[] = {SIGNAL_JITTER, SIGNAL_IDLE};
+    static const uint32_t rle_buckets[] = {1, 100, 4096};
+    for (uint8_t f = 0; f < CAPTURE_FORMAT_COUNT; f++) {
+        const capture_format *format = &capture_formats[f];
+        if (format->encoding != CAPTURE_ENCODING_RLE) continue;
+        for (uint32_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+            for (uint32_t b = 0; b < sizeof(rle_buckets) / sizeof(rle_buckets[0]); b++) {
+                check_rle(kinds[k], format, rle_buckets[b]);
+            }
+        }
+    }
+
+    // runs of 1 to 40 samples of pseudo random values. 512 samples per
+    // block at 1 channel, buckets of 64 line up with that and 100 do not
+    static const uint8_t channels[] = {1, 2, 4, 8, 16};
+    static const uint32_t raw_buckets[] = {1, 64, 100};
+    for (uint32_t c = 0; c < sizeof(channels) / sizeof(channels[0]); c++) {
+        uint16_t mask = (channels[c] == 16) ? 0xffff : (1u << channels[c]) - 1;
+        samples s = {0};
+        uint32_t x = 0x1a2b3c4d;
+        while (s.len < RAW_SAMPLES) {
+            x = x * 1664525u + 1013904223u;
+            push(&s, (x >> 8) & mask, 1 + (x >> 27) % 40);
+        }
+        // whole bytes at every channel count, no padding samples
+        s.len -= s.len % 8;
+        for (uint32_t b = 0; b < sizeof(raw_buckets) / sizeof(raw_buckets[0]); b++) check_raw(&s, channels[c], raw_buckets[b]);
+        free(s.values);
+    }
+
+    // a bucket of nothing but edges, more than the count holds
+    samples edges = {0};
+    for (uint32_t i = 0; i < 2 * PREVIEW_BUCKETS * 70000; i++) push(&edges, i & 1, 1);
+    check_raw(&edges, 1, 2 * 70000);
+    assert(records[0].buckets[0].transitions == 0xffff && records[0].buckets[0].all_high == 0);
+    assert(records[0].buckets[0].any_high == 1);
+
+    // a width rle_stream does not decode
+    preview p;
+    assert(!preview_init(&p, 1024, 1, 12, on_record, NULL));
+    return 0;
+}
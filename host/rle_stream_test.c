@@ -0,0 +1,141 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture_model.h"
+#include "rle_index.h"
+#include "rle_stream.h"
+#include "signal_corpus.h"
+
+// every rle width in the generated format table decodes the capture model's
+// output the same way in one feed, fed a byte at a time (counters split
+// between feeds) and chunked through rle_index. widths the table does not
+// have are rejected
+
+#define SIGNAL_MS 20
+#define RATE_HZ 125000000u
+#define CHUNK_BYTES 256
+
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t cap;
+} capture;
+
+typedef struct {
+    uint64_t samples;
+    uint64_t high;
+} totals;
+
+static void on_block(const uint8_t *data, uint32_t len, void *ctx) {
+    capture *c = ctx;
+    if (c->len + len > c->cap) {
+        c->cap = (c->cap * 2) + len;
+        c->data = realloc(c->data, c->cap);
+        assert(c->data != NULL);
+    }
+    memcpy(c->data + c->len, data, len);
+    c->len += len;
+}
+
+static void on_run(uint8_t level, uint32_t samples, void *ctx) {
+    totals *t = ctx;
+    t->samples += samples;
+    if (level) t->high += samples;
+}
+
+static void on_span(uint8_t level, uint64_t start, uint32_t samples, void *ctx) {
+    totals *t = ctx;
+    // chunks are decoded in order, every span starts where the last one ended
+    assert(start == t->samples);
+    on_run(level, samples, ctx);
+}
+
+static totals decode(uint8_t counter_bits, const capture *c, uint32_t step) {
+    totals t = {0};
+    rle_decoder dec;
+    assert(rle_decoder_init_width(&dec, counter_bits));
+    for (uint32_t at = 0; at < c->len; at += step) {
+        uint32_t n = (c->len - at < step) ? c->len - at : step;
+        rle_decoder_feed(&dec, c->data + at, n, on_run, &t);
+    }
+    on_run(dec.level, dec.run, &t);
+    assert(t.samples == dec.position);
+    return t;
+}
+
+static totals decode_chunked(uint8_t counter_bits, const capture *c) {
+    totals t = {0};
+    rle_index idx;
+    rle_checkpoint *checkpoints = calloc(rle_index_chunks(c->len, CHUNK_BYTES), sizeof(rle_checkpoint));
+    assert(checkpoints != NULL);
+    assert(rle_index_init(&idx, counter_bits, c->data, c->len, CHUNK_BYTES, checkpoints));
+    for (uint32_t i = 0; i < idx.chunks; i++) rle_index_scan(&idx, i);
+    rle_index_finish(&idx);
+    for (uint32_t i = 0; i < idx.chunks; i++) rle_index_decode(&idx, i, on_span, &t);
+    assert(t.samples == idx.samples);
+    free(checkpoints);
+    return t;
+}
+
+static void check_format(signal_kind kind, const capture_format *format) {
+    capture c = {0};
+    capture_model model;
+    capture_model_init(&model, format, RATE_HZ, on_block, &c);
+    signal_gen gen;
+    signal_corpus_init(&gen, kind, 0);
+    for (uint64_t ns = 0; ns < SIGNAL_MS * 1000000ull;) {
+        signal_segment seg;
+        signal_corpus_next(&gen, &seg);
+        capture_model_feed(&model, seg.levels, seg.duration_ns);
+        ns += seg.duration_ns;
+    }
+    capture_model_flush(&model);
+
+    totals whole = decode(format->counter_bits, &c, c.len);
+    totals bytes = decode(format->counter_bits, &c, 1);
+    totals chunked = decode_chunked(format->counter_bits, &c);
+    printf("kind %d w%u: %u bytes, %llu samples, %llu high\n", kind, format->counter_bits, c.len,
+           (unsigned long long)whole.samples, (unsigned long long)whole.high);
+    // a last byte of packed counters is padded with zero counters, each reads
+    // as a full counter_start run
+    uint64_t padding = whole.samples - model.samples;
+    assert(whole.samples >= model.samples);
+    assert(padding % format->counter_start == 0 && padding / format->counter_start < format->units_per_byte);
+    assert(bytes.samples == whole.samples && bytes.high == whole.high);
+    assert(chunked.samples == whole.samples && chunked.high == whole.high);
+    free(c.data);
+}
+
+int main(void) {
+    // short runs, and long ones that saturate every width
+    static const signal_kind kinds[] = {SIGNAL_JITTER, SIGNAL_IDLE};
+    uint32_t widths = 0;
+    for (uint8_t i = 0; i < CAPTURE_FORMAT_COUNT; i++) {
+        const capture_format *format = &capture_formats[i];
+        if (format->encoding != CAPTURE_ENCODING_RLE) continue;
+        widths++;
+        for (uint32_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) check_format(kinds[k], format);
+    }
+    assert(widths > 0);
+
+    static const uint8_t unknown[] = {0, 1, 12, 32};
+    for (uint32_t i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++) {
+        rle_decoder dec;
+        rle_unpack unpack;
+        rle_index idx;
+        rle_checkpoint cp = {0};
+        assert(!rle_unpack_init(&unpack, unknown[i]));
+        assert(!rle_decoder_init_width(&dec, unknown[i]));
+        assert(!rle_decoder_init_at(&dec, unknown[i], &cp));
+        assert(!rle_index_init(&idx, unknown[i], NULL, 0, CHUNK_BYTES, &cp));
+    }
+    // chunks have to start on a counter
+    rle_index idx;
+    rle_checkpoint cp = {0};
+    assert(!rle_index_init(&idx, 16, NULL, 0, CHUNK_BYTES + 1, &cp));
+    assert(!rle_index_init(&idx, 8, NULL, 0, 0, &cp));
+    assert(rle_index_init(&idx, 8, NULL, 0, CHUNK_BYTES + 1, &cp));
+    return 0;
+}
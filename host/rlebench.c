@@ -0,0 +1,186 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capture_formats.h"
+#include "capture_model.h"
+#include "signal_corpus.h"
+#include "rle_stream.h"
+#include "rle_index.h"
+#include "bench_threads.h"
+
+// host side of rlebench.c: checkpointed rle decode over a capture far bigger
+// than the device could hold, with 1 to N threads taking chunks from a shared
+// counter. a model capture is tiled up to the bench size, decoded serially
+// once and then by rle_index per thread count. the sample count and the high
+// samples have to match the serial decode. csv on stdout, same columns as the
+// firmware bench with threads for cores.
+//
+// rlebench [mib [threads [chunk bytes]]], 2048 MiB and every online cpu by default
+
+#define BENCH_SEED 0x1a2b3c4d // same as rlebench.c
+#define BENCH_RATE_HZ 62500000
+#define BENCH_MIB 2048
+#define BENCH_TILE_BYTES (4u << 20) // model output repeated up to the bench size
+#define BENCH_CHUNK_BYTES (64 * 1024)
+
+typedef struct {
+    uint64_t samples;
+    uint64_t high; // samples the pin was high, checked against the serial decode
+} bench_result;
+
+typedef struct {
+    rle_index *idx;
+    atomic_uint next_chunk;
+    bool decode;
+} bench_pass;
+
+typedef struct {
+    bench_pass *pass;
+    bench_result result;
+} bench_worker;
+
+static uint8_t *stream;
+static uint64_t stream_len;
+static uint32_t tile_len;
+
+static uint64_t bench_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000u) + (ts.tv_nsec / 1000);
+}
+
+static void bench_collect(const uint8_t *data, uint32_t len, void *ctx) {
+    (void)ctx;
+    if (len > BENCH_TILE_BYTES - tile_len) len = BENCH_TILE_BYTES - tile_len;
+    memcpy(stream + tile_len, data, len);
+    tile_len += len;
+}
+
+static void bench_run(uint8_t level, uint32_t samples, void *ctx) {
+    bench_result *r = ctx;
+    r->samples += samples;
+    if (level) r->high += samples;
+}
+
+static void bench_span(uint8_t level, uint64_t start, uint32_t samples, void *ctx) {
+    (void)start;
+    bench_run(level, samples, ctx);
+}
+
+static void bench_work(void *arg) {
+    bench_worker *w = arg;
+    bench_pass *pass = w->pass;
+    uint32_t chunk;
+    while ((chunk = atomic_fetch_add(&pass->next_chunk, 1)) < pass->idx->chunks) {
+        if (pass->decode) rle_index_decode(pass->idx, chunk, bench_span, &w->result);
+        else rle_index_scan(pass->idx, chunk);
+    }
+}
+
+static bench_result bench_parallel_pass(rle_index *idx, bench_worker *workers, uint32_t threads, bool decode) {
+    bench_pass pass = {idx, 0, decode};
+    for (uint32_t t = 0; t < threads; t++) {
+        workers[t].pass = &pass;
+        workers[t].result = (bench_result){0};
+    }
+    bench_threads_run(threads, bench_work, workers, sizeof(bench_worker));
+    bench_result total = {0};
+    for (uint32_t t = 0; t < threads; t++) {
+        total.samples += workers[t].result.samples;
+        total.high += workers[t].result.high;
+    }
+    return total;
+}
+
+// a tile of model output, whole counters, copied up to the bench size
+static void bench_fill(const capture_format *format) {
+    capture_model *model = malloc(sizeof(capture_model));
+    assert(model != NULL);
+    tile_len = 0;
+    capture_model_init(model, format, BENCH_RATE_HZ, bench_collect, NULL);
+    signal_gen gen;
+    signal_corpus_init(&gen, SIGNAL_JITTER, BENCH_SEED);
+    while (tile_len < BENCH_TILE_BYTES) {
+        signal_segment seg;
+        signal_corpus_next(&gen, &seg);
+        capture_model_feed(model, seg.levels, seg.duration_ns);
+    }
+    free(model);
+    for (uint64_t at = tile_len; at < stream_len; at += tile_len) {
+        uint64_t n = (stream_len - at < tile_len) ? stream_len - at : tile_len;
+        memcpy(stream + at, stream, n);
+    }
+}
+
+static void bench_format(const capture_format *format, uint32_t max_threads, uint32_t chunk_bytes) {
+    bench_fill(format);
+
+    // serial reference, one decoder over the whole capture
+    bench_result serial = {0};
+    uint64_t start = bench_now_us();
+    rle_decoder dec;
+    assert(rle_decoder_init_width(&dec, format->counter_bits));
+    // feed takes 32 bit lengths
+    for (uint64_t at = 0; at < stream_len; at += 1u << 30) {
+        uint64_t n = (stream_len - at < (1u << 30)) ? stream_len - at : (1u << 30);
+        rle_decoder_feed(&dec, stream + at, (uint32_t)n, bench_run, &serial);
+    }
+    bench_run(dec.level, dec.run, &serial);
+    uint64_t serial_us = bench_now_us() - start;
+    printf("%u,%u,serial,1,%llu,%llu,%.0f,1.00,ok\n", format->id, format->counter_bits,
+        (unsigned long long)stream_len, (unsigned long long)serial_us, (double)stream_len * 1e6 / serial_us);
+    fflush(stdout);
+
+    rle_index idx;
+    rle_checkpoint *checkpoints = malloc((size_t)rle_index_chunks(stream_len, chunk_bytes) * sizeof(rle_checkpoint));
+    bench_worker *workers = calloc(max_threads, sizeof(bench_worker));
+    assert(checkpoints != NULL && workers != NULL);
+    for (uint32_t threads = 1; threads <= max_threads; threads++) {
+        start = bench_now_us();
+        assert(rle_index_init(&idx, format->counter_bits, stream, stream_len, chunk_bytes, checkpoints));
+        bench_parallel_pass(&idx, workers, threads, false);
+        rle_index_finish(&idx);
+        bench_result total = bench_parallel_pass(&idx, workers, threads, true);
+        uint64_t us = bench_now_us() - start;
+        bool ok = total.samples == serial.samples && idx.samples == serial.samples && total.high == serial.high;
+        printf("%u,%u,chunked,%u,%llu,%llu,%.0f,%.2f,%s\n", format->id, format->counter_bits, threads,
+            (unsigned long long)stream_len, (unsigned long long)us, (double)stream_len * 1e6 / us,
+            (double)serial_us / us, ok ? "ok" : "mismatch");
+        fflush(stdout);
+        if (!ok) exit(1);
+    }
+    free(workers);
+    free(checkpoints);
+}
+
+int main(int argc, char **argv) {
+    uint64_t mib = (argc > 1) ? strtoull(argv[1], NULL, 10) : BENCH_MIB;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t max_threads = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : (cpus > 0 ? (uint32_t)cpus : 1);
+    uint32_t chunk_bytes = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 10) : BENCH_CHUNK_BYTES;
+    if (mib == 0) mib = BENCH_MIB;
+    if (max_threads == 0) max_threads = 1;
+
+    stream_len = mib << 20;
+    if (stream_len < BENCH_TILE_BYTES) stream_len = BENCH_TILE_BYTES;
+    stream = malloc(stream_len);
+    if (stream == NULL) {
+        fprintf(stderr, "cant allocate %llu bytes\n", (unsigned long long)stream_len);
+        return 1;
+    }
+
+    printf("# rlebench host seed 0x%08x rate %u Hz chunk %u bytes threads 1 to %u\n", BENCH_SEED, BENCH_RATE_HZ,
+        chunk_bytes, max_threads);
+    printf("format,counter_bits,decode,threads,bytes,us,bytes_per_s,speedup,check\n");
+    for (int f = 0; f < CAPTURE_FORMAT_COUNT; f++) {
+        if (capture_formats[f].encoding == CAPTURE_ENCODING_RLE) bench_format(&capture_formats[f], max_threads, chunk_bytes);
+    }
+    printf("# done\n");
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stream_check.h"
+#include "codec.h"
+
+// a stream with a corrupted crc, a seq gap, a truncated header, stray bytes
+// and a short frame between good blocks. every fault lands in its own
+// counter, the block after a fault still checks out, and the counts do not
+// depend on how the stream is cut into feeds. codec encoded sample blocks
+// are checked against the crc of the decoded samples, one whose codec header
+// disagrees with its frame and one bigger than the checker takes are bad crcs
+
+#define BLOCK_DATA 64
+
+static uint8_t stream[4096];
+static uint32_t stream_len;
+static uint32_t gaps;
+
+static void put(const void *data, uint32_t len) {
+    assert(stream_len + len <= sizeof(stream));
+    memcpy(stream + stream_len, data, len);
+    stream_len += len;
+}
+
+static void put_block(uint32_t seq, bool bad_crc) {
+    uint8_t data[BLOCK_DATA];
+    for (uint32_t i = 0; i < BLOCK_DATA; i++) data[i] = (uint8_t)(seq * 31 + i);
+    stream_block_header header = {STREAM_MAGIC, STREAM_BLOCK_DATA, sizeof(stream_frame) + BLOCK_DATA};
+    stream_frame frame = {seq, BLOCK_DATA, stream_crc32(0, data, BLOCK_DATA), seq * 1000};
+    if (bad_crc) frame.crc ^= 1;
+    put(&header, sizeof(header));
+    put(&frame, sizeof(frame));
+    put(data, BLOCK_DATA);
+}
+
+typedef enum {
+    SAMPLES_GOOD,
+    SAMPLES_BAD_CODEC_BYTES, // codec header bytes not the frame length
+    SAMPLES_OVERSIZE, // frame length past STREAM_CHECK_MAX_BLOCK
+} samples_fault;
+
+// quiet samples compress, busy ones go out raw
+static void put_samples(uint32_t seq, bool busy, samples_fault fault) {
+    uint8_t data[BLOCK_DATA];
+    for (uint32_t i = 0; i < BLOCK_DATA; i++) data[i] = busy ? (uint8_t)(seq * 31 + i * 7) : (uint8_t)(i / 16);
+    uint8_t out[2 * BLOCK_DATA];
+    uint8_t scratch[2 * BLOCK_DATA];
+    uint32_t out_len;
+    codec_type codec = codec_encode_block(data, BLOCK_DATA, out, scratch, &out_len, NULL, NULL);
+    assert(busy == (codec == CODEC_RAW));
+    stream_block_header header = {STREAM_MAGIC, STREAM_BLOCK_SAMPLES,
+        sizeof(stream_frame) + sizeof(codec_block_header) + out_len};
+    stream_frame frame = {seq, BLOCK_DATA, stream_crc32(0, data, BLOCK_DATA), seq * 1000};
+    codec_block_header codec_header = {codec, 8, BLOCK_DATA};
+    if (fault == SAMPLES_BAD_CODEC_BYTES) codec_header.bytes = BLOCK_DATA - 1;
+    if (fault == SAMPLES_OVERSIZE) frame.len = codec_header.bytes = STREAM_CHECK_MAX_BLOCK + 1;
+    put(&header, sizeof(header));
+    put(&frame, sizeof(frame));
+    put(&codec_header, sizeof(codec_header));
+    put(out, out_len);
+}
+
+static void on_gap(uint32_t expected, uint32_t seq, void *ctx) {
+    (void)ctx;
+    assert(expected == 3 && seq == 5);
+    gaps++;
+}
+
+static void check(uint32_t step) {
+    static stream_checker chk;
+    gaps = 0;
+    stream_check_init(&chk, on_gap, NULL);
+    for (uint32_t at = 0; at < stream_len; at += step) {
+        uint32_t n = (stream_len - at < step) ? stream_len - at : step;
+        stream_check_feed(&chk, stream + at, n);
+    }
+    const stream_check_counts *c = &chk.counts;
+    printf("feeds of %u: %llu blocks, %llu crc, %llu lost, %llu framing, %llu skipped\n", step,
+           (unsigned long long)c->blocks, (unsigned long long)c->crc_errors, (unsigned long long)c->lost_blocks,
+           (unsigned long long)c->framing_errors, (unsigned long long)c->skipped_bytes);
+    // 6 data blocks, 2 sample blocks and the data block after them
+    assert(c->blocks == 9);
+    assert(c->bytes == 9 * BLOCK_DATA);
+    // the corrupted crc, the codec header mismatch and the oversize frame
+    assert(c->crc_errors == 3);
+    assert(c->lost_blocks == 2 && gaps == 1);
+    // the truncated header, the stray bytes and the short frame
+    assert(c->framing_errors == 3);
+    assert(c->skipped_bytes == 3 + 3 + sizeof(stream_block_header) + 4);
+}
+
+int main(void) {
+    put_block(0, false);
+    put_block(1, true);
+    put_block(2, false);
+    // 3 and 4 never made it
+    put_block(5, false);
+    // the first three bytes of a header, the rest went missing. with the
+    // next header's magic it reads as a block longer than any block
+    static const uint8_t truncated[] = {STREAM_MAGIC, STREAM_BLOCK_DATA, 0x07};
+    put(truncated, sizeof(truncated));
+    put_block(6, false);
+    static const uint8_t stray[] = {0x00, 0x11, 0x22};
+    put(stray, sizeof(stray));
+    put_block(7, false);
+    // a data block too short to hold its stream_frame
+    stream_block_header short_header = {STREAM_MAGIC, STREAM_BLOCK_DATA, 4};
+    static const uint8_t short_payload[4] = {0};
+    put(&short_header, sizeof(short_header));
+    put(short_payload, sizeof(short_payload));
+    put_block(8, false);
+    put_samples(9, false, SAMPLES_GOOD);
+    put_samples(10, true, SAMPLES_GOOD);
+    put_samples(11, false, SAMPLES_BAD_CODEC_BYTES);
+    put_samples(12, false, SAMPLES_OVERSIZE);
+    put_block(13, false);
+
+    static const uint32_t steps[] = {1, 3, 7, 64, 4096};
+    for (uint32_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) check(steps[i]);
+    return 0;
+}
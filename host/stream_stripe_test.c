@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stream_stripe.h"
+#include "stream_check.h"
+#include "preview.h"
+
+// a device striping over 2 lanes to a host reading 4 endpoints. capture
+// blocks wait for the format block and come out in seq order across a lost
+// block. a device on more lanes than the host reads, and data on a lane the
+// format block did not announce, fail the stripe. a preview mode stream,
+// fetch replies with out of order seqs on lane 0 and previews on lane 1,
+// comes out in the order it was sent and checks out with nothing lost
+
+#define BLOCK_DATA 32
+
+typedef struct {
+    uint8_t bytes[sizeof(stream_block_header) + sizeof(preview_record) + sizeof(stream_frame) + BLOCK_DATA];
+    uint32_t len;
+} block;
+
+static uint32_t seqs[16];
+static uint32_t seen;
+static uint32_t formats;
+static uint32_t previews;
+
+static void on_block(const uint8_t *data, uint32_t len, void *ctx) {
+    // the preview test checks what comes out as well
+    if (ctx) stream_check_feed(ctx, data, len);
+    stream_block_header header;
+    memcpy(&header, data, sizeof(header));
+    if (header.type == STREAM_BLOCK_FORMAT) {
+        formats++;
+        return;
+    }
+    if (header.type == STREAM_BLOCK_PREVIEW) {
+        previews++;
+        return;
+    }
+    stream_frame frame;
+    memcpy(&frame, data + sizeof(header), sizeof(frame));
+    assert(seen < sizeof(seqs) / sizeof(seqs[0]));
+    seqs[seen++] = frame.seq;
+}
+
+static block capture_block(uint32_t seq) {
+    block b = {.len = sizeof(stream_block_header) + sizeof(stream_frame) + BLOCK_DATA};
+    uint8_t *data = b.bytes + sizeof(stream_block_header) + sizeof(stream_frame);
+    for (uint32_t i = 0; i < BLOCK_DATA; i++) data[i] = (uint8_t)(seq * 7 + i);
+    stream_block_header header = {STREAM_MAGIC, STREAM_BLOCK_DATA, sizeof(stream_frame) + BLOCK_DATA};
+    stream_frame frame = {seq, BLOCK_DATA, stream_crc32(0, data, BLOCK_DATA), 0};
+    memcpy(b.bytes, &header, sizeof(header));
+    memcpy(b.bytes + sizeof(header), &frame, sizeof(frame));
+    return b;
+}
+
+static block preview_block(uint32_t first_bucket) {
+    block b = {.len = sizeof(stream_block_header) + sizeof(preview_record)};
+    stream_block_header header = {STREAM_MAGIC, STREAM_BLOCK_PREVIEW, sizeof(preview_record)};
+    preview_record record = {.first_bucket = first_bucket, .bucket_samples = 1024};
+    memcpy(b.bytes, &header, sizeof(header));
+    memcpy(b.bytes + sizeof(header), &record, sizeof(record));
+    return b;
+}
+
+static block format_block(uint8_t lanes, uint8_t capture_lanes) {
+    block b = {.len = sizeof(stream_block_header) + sizeof(stream_format_record)};
+    stream_block_header header = {STREAM_MAGIC, STREAM_BLOCK_FORMAT, sizeof(stream_format_record)};
+    stream_format_record record = {0, lanes, capture_lanes};
+    memcpy(b.bytes, &header, sizeof(header));
+    memcpy(b.bytes + sizeof(header), &record, sizeof(record));
+    return b;
+}
+
+static bool feed(stream_stripe *stripe, uint8_t lane, block b) {
+    return stream_stripe_feed(stripe, lane, b.bytes, b.len);
+}
+
+int main(void) {
+    static stream_stripe stripe;
+    stream_stripe_init(&stripe, 4, on_block, NULL);
+    // lane 1 gets ahead of lane 0, nothing comes out before the format block
+    assert(feed(&stripe, 1, capture_block(1)));
+    assert(seen == 0);
+    assert(feed(&stripe, 0, format_block(2, 2)));
+    assert(stripe.lanes == 2 && formats == 1 && seen == 0);
+    assert(feed(&stripe, 0, capture_block(0)));
+    // 3 was lost on the device, 4 comes out once both lanes are past it
+    assert(feed(&stripe, 1, capture_block(5)));
+    assert(feed(&stripe, 0, capture_block(2)));
+    assert(feed(&stripe, 0, capture_block(4)));
+    static const uint32_t expected[] = {0, 1, 2, 4, 5};
+    assert(seen == sizeof(expected) / sizeof(expected[0]));
+    assert(memcmp(seqs, expected, sizeof(expected)) == 0);
+    // the device did not announce lane 2
+    assert(!feed(&stripe, 2, capture_block(6)));
+    assert(stripe.failed && !feed(&stripe, 0, capture_block(6)));
+
+    // the device stripes over more lanes than the host reads
+    stream_stripe_init(&stripe, 2, on_block, NULL);
+    assert(!feed(&stripe, 0, format_block(4, 4)));
+    assert(stripe.failed);
+    // more capture lanes than lanes
+    stream_stripe_init(&stripe, 4, on_block, NULL);
+    assert(!feed(&stripe, 0, format_block(2, 3)));
+    printf("lane count checks passed\n");
+
+    // preview mode: the host fetched 100 to 104, then went back for 7 and 8
+    static stream_checker chk;
+    stream_check_init(&chk, NULL, NULL);
+    stream_stripe_init(&stripe, 4, on_block, &chk);
+    seen = formats = 0;
+    assert(feed(&stripe, 1, preview_block(0)));
+    // the first reply in the same transfer as the format block
+    static const uint32_t fetched[] = {100, 101, 102, 103, 104, 7, 8};
+    block first = format_block(2, 0);
+    block reply = capture_block(fetched[0]);
+    memcpy(first.bytes + first.len, reply.bytes, reply.len);
+    first.len += reply.len;
+    assert(feed(&stripe, 0, first));
+    assert(stripe.lanes == 2 && stripe.capture_lanes == 0 && previews == 1 && seen == 1);
+    for (uint32_t i = 1; i < sizeof(fetched) / sizeof(fetched[0]); i++) {
+        assert(feed(&stripe, 0, capture_block(fetched[i])));
+        if (i % 2) assert(feed(&stripe, 1, preview_block(16 * (i + 1))));
+    }
+    assert(seen == sizeof(fetched) / sizeof(fetched[0]));
+    assert(memcmp(seqs, fetched, sizeof(fetched)) == 0);
+    assert(previews == 4 && stripe.overflows == 0);
+    const stream_check_counts *c = &chk.counts;
+    printf("preview: %llu blocks, %llu lost, %llu crc, %llu framing\n", (unsigned long long)c->blocks,
+           (unsigned long long)c->lost_blocks, (unsigned long long)c->crc_errors, (unsigned long long)c->framing_errors);
+    assert(c->blocks == sizeof(fetched) / sizeof(fetched[0]));
+    assert(c->lost_blocks == 0 && c->crc_errors == 0 && c->framing_errors == 0 && c->skipped_bytes == 0);
+    // fetch replies never go out on the preview lane
+    assert(!feed(&stripe, 1, capture_block(9)));
+    return 0;
+}
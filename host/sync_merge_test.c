@@ -0,0 +1,185 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture_model.h"
+#include "signal_corpus.h"
+#include "sync_merge.h"
+
+// two analyzers with different sample clocks and start times capture their
+// own data line and see the same sync line. the device side is simulated:
+// the sync irq reads the dma a random latency after the edge, with the
+// fifo holding a random number of words, and a few records are dropped.
+// every sync edge, dropped or not, has to land within the skew bound of
+// where the reference saw it
+
+#define EDGES 64
+#define FIRST_EDGE_NS 2000000u
+#define FEED_BYTES 100
+#define LATENCY_NS 3200 // 400 cycles at 125 MHz
+
+typedef struct {
+    capture_model model;
+    signal_gen gen;
+    signal_segment seg; // duration_ns is what is left of it
+    uint64_t start_ns; // reference time of the device's sample 0
+    uint64_t time_ns; // device time fed so far
+    uint8_t *data;
+    uint64_t len;
+    uint64_t cap;
+    uint8_t counter_bytes;
+    uint16_t latency_samples;
+    stream_sync_record records[EDGES];
+    uint64_t truth[EDGES]; // sample position of each edge
+    bool dropped[EDGES];
+    sync_point points[EDGES];
+    uint32_t found;
+} device;
+
+static uint32_t rng = 12345;
+
+static uint32_t next_random(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void on_block(const uint8_t *data, uint32_t len, void *ctx) {
+    device *dev = ctx;
+    if (dev->len + len > dev->cap) {
+        dev->cap = (dev->cap * 2) + len;
+        dev->data = realloc(dev->data, dev->cap);
+        assert(dev->data != NULL);
+    }
+    memcpy(dev->data + dev->len, data, len);
+    dev->len += len;
+}
+
+static void device_init(device *dev, uint8_t counter_bits, uint64_t rate_hz, uint64_t start_ns, signal_kind kind) {
+    memset(dev, 0, sizeof(*dev));
+    const capture_format *format = capture_format_find(CAPTURE_ENCODING_RLE, 1, counter_bits);
+    assert(format != NULL);
+    capture_model_init(&dev->model, format, rate_hz, on_block, dev);
+    signal_corpus_init(&dev->gen, kind, start_ns);
+    signal_corpus_next(&dev->gen, &dev->seg);
+    dev->start_ns = start_ns;
+    dev->counter_bytes = counter_bits / 8;
+    dev->latency_samples = (uint16_t)(((LATENCY_NS * rate_hz) + 999999999u) / 1000000000u);
+}
+
+static void device_advance(device *dev, uint64_t ref_ns) {
+    uint64_t until = ref_ns - dev->start_ns;
+    while (dev->time_ns < until) {
+        uint64_t take = until - dev->time_ns;
+        if (take > dev->seg.duration_ns) take = dev->seg.duration_ns;
+        capture_model_feed(&dev->model, dev->seg.levels, (uint32_t)take);
+        dev->time_ns += take;
+        dev->seg.duration_ns -= (uint32_t)take;
+        if (dev->seg.duration_ns == 0) signal_corpus_next(&dev->gen, &dev->seg);
+    }
+}
+
+// bytes the pio would have pushed by now. the model only writes a run when
+// it ends, the pio also pushes a saturated counter and its filler every time
+// the counter runs out during the run
+static uint64_t device_bytes(const device *dev) {
+    uint64_t saturated = (1u << dev->model.format->counter_bits) - 1;
+    uint64_t pieces = dev->model.run / saturated;
+    return dev->len + (dev->model.bit / 8) + (pieces * 2 * dev->counter_bytes);
+}
+
+// what the sync irq would send for an edge at ref_ns
+static void device_edge(device *dev, uint32_t edge, uint64_t ref_ns) {
+    device_advance(dev, ref_ns);
+    dev->truth[edge] = dev->model.samples;
+    // the pio keeps going until the irq reads the dma count, the dma is up
+    // to 4 fifo words and the partly filled isr behind it
+    device_advance(dev, ref_ns + (next_random() % (LATENCY_NS + 1u)));
+    uint64_t bytes = device_bytes(dev);
+    uint64_t lag = (bytes % 4) + (4 * (next_random() % 5));
+    if (lag > bytes) lag = bytes;
+    dev->records[edge] = (stream_sync_record){
+        .edge = edge,
+        .level = (edge + 1) & 1u,
+        .latency_samples = dev->latency_samples,
+        .data_offset = bytes - lag,
+    };
+}
+
+static void on_run(uint8_t level, uint32_t samples, void *ctx) {
+    (void)level;
+    (void)samples;
+    (void)ctx;
+}
+
+// the host gets sync records before the data they point into, hand each to
+// the locator before the data reaches its window
+static void device_locate(device *dev) {
+    sync_locator loc;
+    assert(sync_locator_init(&loc, dev->model.format->counter_bits));
+    bool added[EDGES] = {false};
+    for (uint64_t at = 0; at < dev->len; at += FEED_BYTES) {
+        uint32_t n = (dev->len - at < FEED_BYTES) ? (uint32_t)(dev->len - at) : FEED_BYTES;
+        for (uint32_t e = 0; e < EDGES; e++) {
+            const stream_sync_record *rec = &dev->records[e];
+            if (added[e] || dev->dropped[e]) continue;
+            if (rec->data_offset >= at + n) continue;
+            assert(rec->data_offset >= at);
+            assert(sync_locator_add(&loc, rec));
+            added[e] = true;
+        }
+        dev->found += sync_locator_feed(&loc, dev->data + at, n, on_run, NULL, dev->points + dev->found,
+                                        EDGES - dev->found);
+    }
+}
+
+int main(void) {
+    static device devices[2];
+    device *ref = &devices[0];
+    device *dev = &devices[1];
+    // +30 ppm at 125 MHz with 8 bit counters, -45 ppm at 62.5 MHz with 16 bit
+    // counters starting 1.234567 ms later
+    device_init(ref, 8, 125003750, 0, SIGNAL_UART);
+    device_init(dev, 16, 62497187, 1234567, SIGNAL_JITTER);
+    ref->dropped[20] = true;
+    dev->dropped[10] = true;
+    dev->dropped[11] = true;
+    dev->dropped[30] = true;
+
+    uint64_t t = FIRST_EDGE_NS;
+    for (uint32_t e = 0; e < EDGES; e++) {
+        for (int d = 0; d < 2; d++) device_edge(&devices[d], e, t);
+        t += 100000 + (next_random() % 300000);
+    }
+    for (int d = 0; d < 2; d++) {
+        device_advance(&devices[d], t + 1000000);
+        capture_model_flush(&devices[d].model);
+        device_locate(&devices[d]);
+        assert(devices[d].found == EDGES - (d == 0 ? 1 : 3));
+        // the locator window has to hold the true edge
+        for (uint32_t i = 0; i < devices[d].found; i++) {
+            const sync_point *p = &devices[d].points[i];
+            assert(devices[d].truth[p->edge] >= p->sample);
+            assert(devices[d].truth[p->edge] <= p->sample + p->uncertainty);
+        }
+    }
+
+    sync_alignment align;
+    assert(sync_align(ref->points, ref->found, dev->points, dev->found, &align));
+    assert(align.matched == EDGES - 4);
+    double true_scale = 125003750.0 / 62497187.0;
+    double true_offset = 1234567.0 * 125003750.0 / 1e9;
+    printf("scale %.9f (%.9f) offset %.1f (%.1f) skew bound %u samples\n", align.scale, true_scale, align.offset,
+           true_offset, align.skew_bound);
+    // the line reaches back to where the device started, before the first sync edge
+    assert(fabs(align.offset - true_offset) <= align.skew_bound);
+    for (uint32_t e = 0; e < EDGES; e++) {
+        int64_t miss = (int64_t)sync_map(&align, dev->truth[e]) - (int64_t)ref->truth[e];
+        if (miss < 0) miss = -miss;
+        assert(miss <= align.skew_bound);
+    }
+    return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "pico/platform.h"
+
+// linker section policy:
+// functions on the usb irq and capture hot path are wrapped in HOT_PATH_FUNC.
+// with HOT_PATH_IN_RAM they go to .time_critical which crt0 copies to sram at
+// boot, so a refill never waits on an xip cache miss. everything else stays
+// in flash. COPY_TO_RAM in CMakeLists.txt moves the whole binary instead.
+#if HOT_PATH_IN_RAM
+#define HOT_PATH_FUNC(name) __not_in_flash_func(name)
+#else
+#define HOT_PATH_FUNC(name) name
+#endif
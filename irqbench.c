@@ -0,0 +1,106 @@
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "usb_handler.h"
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+
+// irq latency benchmark, measures cycles from usb irq entry to the ep2 buffer
+// being handed back to the controller. keep any bulk reader running on ep2,
+// results are printed over uart. build with -DBUILD_IRQ_BENCH=ON and compare
+// -DHOT_PATH_IN_RAM=ON/OFF. the entry stamp comes from the sram trampoline in
+// usb_handler.c, so with the hot path in flash the numbers include fetching
+// the handler itself. the fixed exception entry before the stamp (15 cycles)
+// is the same in both builds
+
+#define BENCH_SAMPLES 100000
+#define BENCH_BUCKET_CYCLES 8
+#define BENCH_BUCKETS 512 // last bucket takes everything above 4k cycles
+#define FLASH_THRASH_SIZE (256 * 1024) // way bigger than the 16k xip cache
+#define XIP_CACHE_LINE 8
+
+static uint32_t hist[BENCH_BUCKETS];
+static uint32_t worst = 0;
+static volatile uint32_t samples = 0;
+static volatile bool running = false;
+static volatile bool thrash = false;
+static uint8_t payload[64];
+
+void ep2_func(end_point *ep, uint8_t should_handle) {
+    // hand the buffer that just went out straight back to the controller
+    usb_ep2_send(should_handle & 1, payload, 64);
+    if (!running) return;
+    uint32_t cycles = stats_last_irq_to_avail();
+    if (cycles > worst) worst = cycles;
+    uint32_t bucket = cycles / BENCH_BUCKET_CYCLES;
+    if (bucket >= BENCH_BUCKETS) bucket = BENCH_BUCKETS - 1;
+    hist[bucket]++;
+    samples++;
+}
+
+// core1 keeps evicting the xip cache so core0 code in flash misses
+void core1_thrash(void) {
+    const volatile uint8_t *flash = (const volatile uint8_t *)XIP_BASE;
+    volatile uint32_t sink = 0;
+    while (1) {
+        if (!thrash) continue;
+        for (uint32_t i = 0; i < FLASH_THRASH_SIZE; i += XIP_CACHE_LINE) sink += flash[i];
+        xip_ctrl_hw->flush = 1;
+    }
+}
+
+static void bench_run(const char *name, bool pressure) {
+    running = false;
+    memset(hist, 0, sizeof(hist));
+    worst = 0;
+    samples = 0;
+    thrash = pressure;
+    running = true;
+    while (samples < BENCH_SAMPLES) tight_loop_contents();
+    // the irq runs on this core, once running is clear no handler is left
+    // halfway through the histogram. irqs that came in after the wait ended
+    // are in it too, so the count is taken from samples and not BENCH_SAMPLES
+    running = false;
+    __compiler_memory_barrier();
+    uint32_t count = samples;
+    thrash = false;
+
+    // walk the histogram until 99% of the samples are covered
+    uint32_t target = (uint32_t)(((uint64_t)count * 99) / 100);
+    uint32_t seen = 0;
+    uint32_t p99 = 0;
+    for (int i = 0; i < BENCH_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= target) {
+            p99 = (i + 1) * BENCH_BUCKET_CYCLES;
+            break;
+        }
+    }
+    float cycles_per_us = clock_get_hz(clk_sys) / 1000000.0f;
+    printf("%s: %lu samples, worst %lu cycles (%.2f us), p99 <= %lu cycles (%.2f us)\n",
+        name, count, worst, worst / cycles_per_us, p99, p99 / cycles_per_us);
+}
+
+int main() {
+    stdio_init_all();
+    stats_init();
+    usb_init();
+
+    while (!usb_is_configured()) tight_loop_contents();
+    printf("irq bench, hot path in %s\n", HOT_PATH_IN_RAM ? "sram" : "flash");
+
+    usb_register_ep2_in_func(ep2_func);
+    multicore_launch_core1(core1_thrash);
+
+    // prime both buffers, the irq keeps them going from here
+    usb_ep2_send(0, payload, 64);
+    usb_ep2_send(1, payload, 64);
+
+    while (1) {
+        bench_run("idle", false);
+        bench_run("xip pressure", true);
+    }
+}
@@ -3,45 +3,706 @@
 #include "pinpoller.h"
 #include "hardware/pio.h"
 #include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "dma_handler.h"
 #include "usb_handler.h"
+#include "stats.h"
+#include "measure.h"
+#include "rle_stream.h"
+#include "stream.h"
+#include "stream_format.h"
+#include "codec.h"
+#include "preview.h"
+#include "sched.h"
+#include "hot_path.h"
+#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define PIN 28
+#define FILTERED_PIN 27 // leave unconnected, the deglitch stage drives it
+#define SYNC_PIN 26 // sync line shared between analyzers in stream mode
+#define MULTI_BASE_PIN 2 // channels on pins 2 and up, 0 and 1 are the uart
 
-#define TX_PAYLOAD 0xFEFEFEFE
+#define BUF_WORDS 1024
+#define HALF_WORDS (BUF_WORDS / 2)
+#define HALF_BYTES (HALF_WORDS * sizeof(uint32_t))
+#define SYNC_SLOTS 8
+#define SYNC_CALIBRATION_EDGES 32 // forced sync edges timed when the stream starts
+// full resolution halves kept in preview mode for the fetch command. the
+// host has RING_BLOCKS * HALF_BYTES / data rate to ask for a block after its
+// preview. 64 blocks (128 kB) is about 100 ms at the full speed bulk rate
+// and leaves half of the 264 kB sram for the rest. set from cmake
+#ifndef PREVIEW_RING_BLOCKS
+#define PREVIEW_RING_BLOCKS 64
+#endif
+#define RING_BLOCKS PREVIEW_RING_BLOCKS
+#define FETCH_SLOTS 2 // fetched blocks are copied out of the ring into these
+#define PREVIEW_SLOTS 4
+#define PREVIEW_LANE 1 // fetched blocks go out on lane 0
+#define GLITCH_THRESHOLD_MAX 125000 // 1 ms at 125 MHz, anything longer is not a glitch
 
+typedef enum {
+    MODE_IDLE,
+    MODE_CAPTURE, // one buffer of raw pinpoller output
+    MODE_MEASURE, // only summary records go out over ep2
+    MODE_STREAM, // continuous pinpoller output and sync edges over ep2
+    MODE_MULTI, // several pins sampled together, core1 picks a codec per block
+    MODE_PREVIEW, // summaries go out live, full resolution blocks stay in a ring until fetched
+} capture_mode;
+
+typedef struct {
+    stream_block_header header;
+    stream_sync_record record;
+} __packed sync_block;
+
+typedef struct {
+    stream_block_header header;
+    stream_frame frame;
+} __packed frame_block_header;
+
+static capture_mode mode = MODE_IDLE;
+static uint glitch_threshold = 0; // 0 skips the deglitch stage
+static uint16_t measure_interval_ms = 1000;
+static uint8_t counter_bits = RLE_DEFAULT_COUNTER_BITS; // pinpoller counter width
+static uint8_t lanes = 1; // data endpoints capture blocks are striped over
+static uint32_t buf[BUF_WORDS] = {0};
+static char cmd[65]; // last ep1 command, written from the usb irq until on_command takes it
+
+// the running capture, set up by the command that starts it
+static poller_program prog;
+static deglitch_filter filter;
+static bool deglitch = false;
+static int channel_rx = 0;
+static uint32_t sm_mask = 0;
+static uint32_t *halves[2] = {buf, buf + HALF_WORDS};
+static uint8_t half = 0; // half the getter is writing
+static bool block_waiting = false; // a half is done but could not be handed on yet
+static bool queued[2] = {false, false}; // half is with the stream
+static uint32_t tickets[2];
+
+// measure mode
+static uint8_t ep2_buf = 0;
+static uint32_t next_record = 0;
+
+// stream mode state, the sync irq needs to know where the capture is
+static volatile uint64_t data_blocks = 0; // data halves handed to the stream
+static frame_block_header headers[2];
+static sync_block sync_blocks[SYNC_SLOTS];
+static uint32_t sync_tickets[SYNC_SLOTS];
+static bool sync_queued[SYNC_SLOTS] = {false};
+static uint32_t sync_edges = 0;
+static uint8_t sync_level = 0; // level after the last edge the sync irq handled
+static uint16_t sync_latency_samples = 0; // samples the pio can take between an edge and the dma read
+static volatile bool sync_calibrating = false;
+static volatile uint32_t sync_forced_at = 0; // systick right before a forced edge
+static uint32_t sync_latency_max = 0; // worst forced edge to dma read, in cycles
+
+// multi pin mode, core1 encodes raw halves of buf into these
+#define ENCODED_HEADERS (sizeof(frame_block_header) + sizeof(codec_block_header))
+#define CODEC_BUDGET_MAX (1u << 23) // well inside the 24 bit systick
+static uint16_t multi_clkdiv = 125; // 1 MHz at the default clock
+static uint8_t multi_channels = 8;
+static uint8_t encoded[2][ENCODED_HEADERS + HALF_BYTES];
+static stream_frame multi_frames[2]; // filled by core0 before the half goes to core1
+static sampler_program sampler;
+static uint32_t multi_seq = 0;
+static bool busy[2] = {false, false}; // raw half is with core1
+static bool encode_pending = false; // half ^ 1 is done but its encode buffer is still with the stream
+static volatile uint32_t codec_done = 0; // bit per half core1 has finished
+static volatile uint32_t codec_len[2]; // encoded bytes per finished half
+static uint8_t codec_scratch[HALF_BYTES];
+static uint32_t codec_budget_cycles; // core1 cycles per half before it gives up compressing
+
+typedef struct {
+    uint32_t start; // systick on core1 when the half came in
+    bool over;
+} codec_budget;
+
+// preview mode, the getter writes straight into the ring instead of buf
+typedef struct {
+    stream_block_header header;
+    preview_record record;
+} __packed preview_block;
+
+typedef struct {
+    frame_block_header header;
+    uint32_t data[HALF_WORDS];
+} __packed fetch_block;
+
+_Static_assert(RING_BLOCKS >= 2 && RING_BLOCKS * HALF_BYTES <= 160 * 1024, "preview ring does not fit the sram");
+
+static uint32_t ring[RING_BLOCKS][HALF_WORDS];
+static frame_block_header ring_headers[RING_BLOCKS];
+static uint32_t ring_written = 0; // blocks the getter has finished
+static fetch_block fetch_blocks[FETCH_SLOTS];
+static uint32_t fetch_tickets[FETCH_SLOTS];
+static bool fetch_queued[FETCH_SLOTS] = {false};
+static uint32_t fetch_next = 0; // next block the host asked for
+static uint32_t fetch_end = 0;
+static bool preview_sampled = false; // multi pin samples instead of pinpoller output
+static uint32_t preview_bucket_samples = 1024;
+static preview pv;
+static preview_block preview_blocks[PREVIEW_SLOTS];
+static uint32_t preview_tickets[PREVIEW_SLOTS];
+static bool preview_queued[PREVIEW_SLOTS] = {false};
+static uint32_t preview_records = 0;
 
-static bool start = false;
 void ep1_func(uint8_t *buffer, uint8_t *len) {
-    if (strcmp(buffer, "start") == 0) start = true;
+    // commands are plain strings, terminate them here. on_command does the rest
+    memcpy(cmd, buffer, *len);
+    cmd[*len] = '\0';
 }
 
-int main() {
-    stdio_init_all();
-    usb_init();
+// consumes the pinpoller stream on the device and only sends summaries
+static void measure_block(void) {
+    uint8_t done = half;
+    // restart into the other half straight away, the pio fifo covers the gap
+    half ^= 1;
+    dma_channel_set_write_addr(channel_rx, halves[half], true);
+    stats_count_dma_block();
+    if (pinpoller_rx_stalled(prog.pio, prog.sm)) stats_count_fifo_stall();
+    measure_feed((uint8_t *)halves[done], HALF_BYTES);
 
-    poller_program prog = {PIN, pio0, pio_claim_unused_sm(pio0, true), SR_125MHZ};
-    pinpoller_program_init(prog);
-    
-    uint32_t buf[1024] = {0};
-    
-    int channel_rx = init_getter_dma(buf, 1024, prog);
-    uint32_t payload = TX_PAYLOAD;
-    int channel_tx = init_setter_dma(&payload, prog);
+    if ((int32_t)(time_us_32() - next_record) < 0) return;
+    next_record += measure_interval_ms * 1000;
+    measure_record rec;
+    measure_take_record(&rec);
+    // host is not keeping up, drop it. the seq field shows the gap
+    if (!usb_ep2_ready(ep2_buf)) return;
+    usb_ep2_send(ep2_buf, (uint8_t *)&rec, sizeof(rec));
+    ep2_buf ^= 1;
+}
 
-    while (!start) tight_loop_contents();
-    pinpoller_clear_fifo(prog);
-    dma_channel_start(channel_rx);
-    pio_sm_set_enabled(prog.pio, prog.sm, true);
+static void start_measurement(void) {
+    if (!measure_init(measure_interval_ms, prog.counter_bits)) assert(0 && "counter width checked by on_command");
+    next_record = time_us_32() + (measure_interval_ms * 1000);
+    sched_register(SCHED_EVENT_CAPTURE_BLOCK, measure_block);
+    dma_channel_set_trans_count(channel_rx, HALF_WORDS, false);
+    dma_channel_set_write_addr(channel_rx, halves[half], true);
+    pio_set_sm_mask_enabled(prog.pio, sm_mask, true);
+}
+
+static void HOT_PATH_FUNC(sync_record)(uint32_t edge, uint8_t level, uint64_t offset) {
+    uint8_t slot = edge % SYNC_SLOTS;
+    // slot still waiting for the host, drop this edge. the host sees the gap in edge
+    if (sync_queued[slot] && !stream_sent(sync_tickets[slot])) return;
+
+    sync_block *block = &sync_blocks[slot];
+    block->header = (stream_block_header){STREAM_MAGIC, STREAM_BLOCK_SYNC, sizeof(stream_sync_record)};
+    block->record.edge = edge;
+    block->record.level = level;
+    block->record.latency_samples = sync_latency_samples;
+    block->record.data_offset = offset;
+    block->record.time_us = time_us_64();
+    sync_queued[slot] = stream_queue((uint8_t *)block, sizeof(sync_block), &sync_tickets[slot]);
+}
+
+// records where in the data the sync line changed. a raw bank0 handler at
+// the highest priority rather than the sdk gpio callback, that one looks up
+// the pin and calls through a pointer before anything here runs
+static void HOT_PATH_FUNC(sync_irq)(void) {
+    // data bytes written so far, the current half is partly done
+    uint32_t words_left = dma_hw->ch[channel_rx].transfer_count;
+    if (sync_calibrating) {
+        uint32_t latency = stats_sync_latency(sync_forced_at);
+        if (latency > sync_latency_max) sync_latency_max = latency;
+    }
+    uint64_t offset = (data_blocks * HALF_BYTES) + ((HALF_WORDS - words_left) * sizeof(uint32_t));
+
+    // the level comes from the latched edges, the pin may have moved on since
+    uint32_t shift = 4 * (SYNC_PIN % 8);
+    uint32_t events = (io_bank0_hw->proc0_irq_ctrl.ints[SYNC_PIN / 8] >> shift) & (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL);
+    io_bank0_hw->intr[SYNC_PIN / 8] = events << shift;
+    if (sync_calibrating || events == 0) return;
 
-    dma_channel_wait_for_finish_blocking(channel_rx);
-    pio_sm_set_enabled(prog.pio, prog.sm, false);
+    if (events == (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL)) {
+        // a pulse shorter than the irq latency, both edges sit at the same offset
+        sync_level ^= 1u;
+        sync_record(sync_edges++, sync_level, offset);
+        sync_level ^= 1u;
+    } else {
+        sync_level = (events == GPIO_IRQ_EDGE_RISE);
+    }
+    sync_record(sync_edges++, sync_level, offset);
+    stream_kick();
+}
+
+// forces edges on the sync input and times each one to the dma read in the
+// sync irq, with the capture and usb running. the worst of them goes out
+// with every sync record
+static void sync_calibrate(void) {
+    sync_latency_max = 0;
+    sync_calibrating = true;
+    for (int i = 0; i < SYNC_CALIBRATION_EDGES; i++) {
+        sync_forced_at = stats_cycles();
+        gpio_set_inover(SYNC_PIN, (i & 1) ? GPIO_OVERRIDE_HIGH : GPIO_OVERRIDE_LOW);
+        busy_wait_us_32(20);
+    }
+    gpio_set_irq_enabled(SYNC_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+    gpio_set_inover(SYNC_PIN, GPIO_OVERRIDE_NORMAL);
+    sync_calibrating = false;
+    sync_level = gpio_get(SYNC_PIN);
+    // the pinpoller takes a sample every 2 pio cycles
+    uint32_t cycles_per_sample = 2 * prog.poll_rate;
+    uint32_t samples = (sync_latency_max + cycles_per_sample - 1) / cycles_per_sample;
+    sync_latency_samples = (samples > UINT16_MAX) ? UINT16_MAX : samples;
+    // enabling acks whatever the real line did meanwhile
+    gpio_set_irq_enabled(SYNC_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+}
 
+// hands a finished half to the stream and re-arms the getter. also runs on
+// every ep2 packet while the other half is still waiting for the host
+static void stream_rearm(void) {
+    // the other half has to be out to the host before it is written again,
+    // if the host is too slow the pio stalls and that shows up in the stats
+    if (!block_waiting || (queued[half ^ 1] && !stream_sent(tickets[half ^ 1]))) return;
+    block_waiting = false;
+    uint8_t done = half;
+    half ^= 1;
+    // the sync irq must not see the new count with the old block number
+    uint32_t status = save_and_disable_interrupts();
+    uint32_t crc = take_getter_crc();
+    uint32_t seq = data_blocks++;
+    dma_channel_set_write_addr(channel_rx, halves[half], true);
+    restore_interrupts(status);
+    stats_count_dma_block();
+    if (pinpoller_rx_stalled(prog.pio, prog.sm)) stats_count_fifo_stall();
 
-    
+    // the header went out ahead of this half last time, so it is free again
+    headers[done].frame.seq = seq;
+    headers[done].frame.crc = crc;
+    headers[done].frame.time_us = time_us_64();
+    // block n goes out on lane n % lanes, sync records stay on lane 0.
+    // two data halves and the sync slots never fill a queue
+    uint8_t lane = seq % stream_lanes();
+    stream_queue_lane(lane, (uint8_t *)&headers[done], sizeof(frame_block_header), NULL);
+    queued[done] = stream_queue_lane(lane, (uint8_t *)halves[done], HALF_BYTES, &tickets[done]);
+    stats_block_ready();
+    stream_kick();
+}
+
+static void stream_block(void) {
+    block_waiting = true;
+    stream_rearm();
+}
+
+// the host needs the format and the lane counts before the first capture
+// block, call after stream_init
+static void queue_format(uint8_t id, uint8_t capture_lanes) {
+    static struct {
+        stream_block_header header;
+        stream_format_record record;
+    } __packed format_block;
+
+    format_block.header = (stream_block_header){STREAM_MAGIC, STREAM_BLOCK_FORMAT, sizeof(stream_format_record)};
+    format_block.record = (stream_format_record){id, stream_lanes(), capture_lanes};
+    stream_queue((uint8_t *)&format_block, sizeof(format_block), NULL);
+}
+
+// streams pinpoller output with sync edges in between
+static void start_stream(void) {
+    stream_init(lanes);
+    data_blocks = 0;
+    for (int i = 0; i < 2; i++) {
+        headers[i].header = (stream_block_header){STREAM_MAGIC, STREAM_BLOCK_DATA, sizeof(stream_frame) + HALF_BYTES};
+        headers[i].frame.len = HALF_BYTES;
+    }
+    queue_format(pinpoller_format(prog)->id, stream_lanes());
+    gpio_init(SYNC_PIN);
+    gpio_set_dir(SYNC_PIN, false);
+    irq_set_exclusive_handler(IO_IRQ_BANK0, sync_irq);
+    irq_set_priority(IO_IRQ_BANK0, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    sched_register(SCHED_EVENT_CAPTURE_BLOCK, stream_block);
+    sched_register(SCHED_EVENT_EP2_DONE, stream_rearm);
+    init_getter_crc(channel_rx);
+    dma_channel_set_trans_count(channel_rx, HALF_WORDS, false);
+    dma_channel_set_write_addr(channel_rx, halves[half], true);
+    pio_set_sm_mask_enabled(prog.pio, sm_mask, true);
+    gpio_set_irq_enabled(SYNC_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+    sync_calibrate();
+}
+
+// core1 has to be done with a half before the sampler fills the other one
+static bool codec_within_budget(void *ctx) {
+    codec_budget *budget = ctx;
+    budget->over = stats_cycles_elapsed(budget->start) >= codec_budget_cycles;
+    return !budget->over;
+}
+
+// core1 side of multi pin mode, gets a half index and sends back (length << 1) | half
+static void core1_codec(void) {
+    stats_cycles_init();
     while (1) {
-        printf("aa");
+        uint32_t half = multicore_fifo_pop_blocking();
+        codec_budget budget = {stats_cycles(), false};
+        uint8_t *out = encoded[half];
+        uint32_t len;
+        codec_type codec = codec_encode_block((uint8_t *)(buf + (half * HALF_WORDS)), HALF_BYTES,
+            out + ENCODED_HEADERS, codec_scratch, &len, codec_within_budget, &budget);
+        frame_block_header header = {
+            {STREAM_MAGIC, STREAM_BLOCK_SAMPLES, sizeof(stream_frame) + sizeof(codec_block_header) + len},
+            multi_frames[half]};
+        codec_block_header codec_header = {codec, multi_channels, HALF_BYTES};
+        memcpy(out, &header, sizeof(header));
+        memcpy(out + sizeof(header), &codec_header, sizeof(codec_header));
+        stats_record_codec(codec, HALF_BYTES, len, stats_cycles_elapsed(budget.start));
+        if (budget.over) stats_count_codec_overrun();
+        multicore_fifo_push_blocking(((ENCODED_HEADERS + len) << 1) | half);
+    }
+}
+
+// core1 pushes (length << 1) | half when it is done, take it off the fifo
+// here so the irq does not stay asserted
+static void codec_irq(void) {
+    while (multicore_fifo_rvalid()) {
+        uint32_t msg = multicore_fifo_pop_blocking();
+        codec_len[msg & 1u] = msg >> 1;
+        codec_done |= 1u << (msg & 1u);
+    }
+    multicore_fifo_clear_irq();
+    sched_post(SCHED_EVENT_CODEC_DONE);
+}
+
+// queues whatever core1 has finished
+static void multi_collect(void) {
+    uint32_t status = save_and_disable_interrupts();
+    uint32_t done = codec_done;
+    codec_done = 0;
+    restore_interrupts(status);
+    for (uint8_t h = 0; h < 2; h++) {
+        if (!(done & (1u << h))) continue;
+        uint8_t lane = multi_frames[h].seq % stream_lanes();
+        queued[h] = stream_queue_lane(lane, encoded[h], codec_len[h], &tickets[h]);
+        busy[h] = false;
+        stats_block_ready();
+        stream_kick();
+    }
+}
+
+// moves halves along as far as they can go, runs on every capture block,
+// codec and ep2 event so nothing waits longer than it has to
+static void multi_service(void) {
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        multi_collect();
+        // core1 has to be done with the other half before the dma writes it again
+        if (block_waiting && !encode_pending && !busy[half ^ 1]) {
+            block_waiting = false;
+            multi_frames[half] = (stream_frame){multi_seq++, HALF_BYTES, take_getter_crc(), time_us_64()};
+            half ^= 1;
+            dma_channel_set_write_addr(channel_rx, halves[half], true);
+            stats_count_dma_block();
+            if (pinpoller_rx_stalled(sampler.pio, sampler.sm)) stats_count_fifo_stall();
+            encode_pending = true;
+            progress = true;
+        }
+        // core1 encodes into the buffer that carried this half last time
+        uint8_t done = half ^ 1;
+        if (encode_pending && (!queued[done] || stream_sent(tickets[done]))) {
+            encode_pending = false;
+            busy[done] = true;
+            multicore_fifo_push_blocking(done);
+            progress = true;
+        }
+    }
+}
+
+static void multi_block(void) {
+    block_waiting = true;
+    multi_service();
+}
+
+static bool start_sampler(void) {
+    sampler = (sampler_program){MULTI_BASE_PIN, pio0, pio_claim_unused_sm(pio0, true), multi_clkdiv, multi_channels};
+    if (!pinsampler_program_init(sampler)) {
+        pio_sm_unclaim(sampler.pio, sampler.sm);
+        return false;
+    }
+    channel_rx = init_getter_dma_sm(buf, HALF_WORDS, sampler.pio, sampler.sm);
+    init_getter_irq(channel_rx);
+    pio_sm_clear_fifos(sampler.pio, sampler.sm);
+    return true;
+}
+
+// samples multi_channels pins and streams codec tagged blocks
+static bool start_multi(void) {
+    if (!start_sampler()) return false;
+    stream_init(lanes);
+    queue_format(pinsampler_format(sampler)->id, stream_lanes());
+    // a quarter of the time the other half takes to fill is left for the raw
+    // copy and handing the block back. systick only counts 24 bits
+    uint32_t fill_cycles = ((HALF_BYTES * 8) / multi_channels) * multi_clkdiv;
+    codec_budget_cycles = (fill_cycles / 4) * 3;
+    if (codec_budget_cycles > CODEC_BUDGET_MAX) codec_budget_cycles = CODEC_BUDGET_MAX;
+    multicore_launch_core1(core1_codec);
+    multicore_fifo_clear_irq();
+    irq_set_exclusive_handler(SIO_IRQ_PROC0, codec_irq);
+    irq_set_enabled(SIO_IRQ_PROC0, true);
+    sched_register(SCHED_EVENT_CAPTURE_BLOCK, multi_block);
+    sched_register(SCHED_EVENT_CODEC_DONE, multi_service);
+    sched_register(SCHED_EVENT_EP2_DONE, multi_service);
+
+    init_getter_crc(channel_rx);
+    dma_channel_set_trans_count(channel_rx, HALF_WORDS, false);
+    dma_channel_set_write_addr(channel_rx, halves[half], true);
+    pio_sm_set_enabled(sampler.pio, sampler.sm, true);
+    return true;
+}
+
+static fetch_block *fetch_free_slot(uint32_t **ticket) {
+    for (int i = 0; i < FETCH_SLOTS; i++) {
+        if (fetch_queued[i] && !stream_sent(fetch_tickets[i])) continue;
+        fetch_queued[i] = false;
+        *ticket = &fetch_tickets[i];
+        return &fetch_blocks[i];
+    }
+    return NULL;
+}
+
+// queues the blocks the host asked for on lane 0, one at a time. runs on the
+// fetch command, every capture block and every ep2 event
+static void fetch_service(void) {
+    while ((int32_t)(fetch_next - fetch_end) < 0 && stream_free(0) >= 1) {
+        // not captured yet, the next capture block carries on
+        if ((int32_t)(fetch_next - ring_written) >= 0) break;
+        // the getter is writing the slot of ring_written, older blocks are
+        // gone. skip ahead, the host sees the gap in seq
+        if (ring_written - fetch_next >= RING_BLOCKS) {
+            fetch_next = ring_written - (RING_BLOCKS - 1);
+            continue;
+        }
+        uint32_t *ticket;
+        fetch_block *out = fetch_free_slot(&ticket);
+        if (out == NULL) break;
+        // the getter only moves to the next slot from preview_capture_block,
+        // so this one stays put while it is copied. the copy is what goes
+        // out, the ring slot can be written again while it is queued
+        uint32_t slot = fetch_next % RING_BLOCKS;
+        out->header = ring_headers[slot];
+        memcpy(out->data, ring[slot], HALF_BYTES);
+        fetch_queued[out - fetch_blocks] = stream_queue_lane(0, (uint8_t *)out, sizeof(fetch_block), ticket);
+        fetch_next++;
     }
-}
\ No newline at end of file
+    stream_kick();
+}
+
+// preview_feed callback, a full record goes out on the preview lane
+static void preview_out(const preview_record *rec, void *ctx) {
+    (void)ctx;
+    uint8_t slot = preview_records++ % PREVIEW_SLOTS;
+    // host is not keeping up, drop it. the gap shows in first_bucket
+    if (preview_queued[slot] && !stream_sent(preview_tickets[slot])) return;
+    preview_blocks[slot].header = (stream_block_header){STREAM_MAGIC, STREAM_BLOCK_PREVIEW, sizeof(preview_record)};
+    preview_blocks[slot].record = *rec;
+    preview_queued[slot] = stream_queue_lane(PREVIEW_LANE, (uint8_t *)&preview_blocks[slot], sizeof(preview_block),
+        &preview_tickets[slot]);
+    stream_kick();
+}
+
+// the getter never waits for the host here, it moves on to the next ring
+// block straight away and the oldest one is written again
+static void preview_capture_block(void) {
+    uint32_t seq = ring_written;
+    uint32_t slot = seq % RING_BLOCKS;
+    uint32_t crc = take_getter_crc();
+    dma_channel_set_write_addr(channel_rx, ring[(seq + 1) % RING_BLOCKS], true);
+    stats_count_dma_block();
+    if (preview_sampled ? pinpoller_rx_stalled(sampler.pio, sampler.sm) : pinpoller_rx_stalled(prog.pio, prog.sm)) {
+        stats_count_fifo_stall();
+    }
+
+    ring_headers[slot].frame = (stream_frame){seq, HALF_BYTES, crc, time_us_64()};
+    ring_written++;
+    preview_feed(&pv, seq, (uint8_t *)ring[slot], HALF_BYTES);
+    fetch_service();
+}
+
+// streams previews of the capture and keeps the last RING_BLOCKS blocks of
+// it for the fetch command, from the pinpoller or from the pin sampler
+static void start_preview(void) {
+    stream_init(PREVIEW_LANE + 1);
+    for (int i = 0; i < RING_BLOCKS; i++) {
+        ring_headers[i].header = (stream_block_header){STREAM_MAGIC, STREAM_BLOCK_DATA, sizeof(stream_frame) + HALF_BYTES};
+    }
+    // before the first preview or fetched block. no capture lanes, capture
+    // blocks only go out as fetch replies and previews have their own lane
+    queue_format(preview_sampled ? pinsampler_format(sampler)->id : pinpoller_format(prog)->id, 0);
+    if (!preview_init(&pv, preview_bucket_samples, multi_channels, preview_sampled ? 0 : prog.counter_bits, preview_out,
+            NULL)) {
+        assert(0 && "preview format checked by on_command");
+    }
+
+    sched_register(SCHED_EVENT_CAPTURE_BLOCK, preview_capture_block);
+    sched_register(SCHED_EVENT_EP2_DONE, fetch_service);
+    init_getter_crc(channel_rx);
+    dma_channel_set_trans_count(channel_rx, HALF_WORDS, false);
+    dma_channel_set_write_addr(channel_rx, ring[0], true);
+    if (preview_sampled) pio_sm_set_enabled(sampler.pio, sampler.sm, true);
+    else pio_set_sm_mask_enabled(prog.pio, sm_mask, true);
+}
+
+// one buffer of raw pinpoller output is in, stop and wait for the next command
+static void capture_done(void) {
+    pio_set_sm_mask_enabled(prog.pio, sm_mask, false);
+    stats_count_dma_block();
+    if (pinpoller_rx_stalled(prog.pio, prog.sm)) stats_count_fifo_stall();
+    if (deglitch) stats_add_glitches(deglitch_filter_glitches(filter));
+    stats_block_ready();
+}
+
+static bool start_poller(void) {
+    prog = (poller_program){PIN, pio0, pio_claim_unused_sm(pio0, true), SR_125MHZ, counter_bits};
+    filter = (deglitch_filter){PIN, FILTERED_PIN, glitch_threshold, pio0, 0, SR_125MHZ};
+    deglitch = glitch_threshold >= 2;
+    // poll the filtered level instead of the raw pin
+    if (deglitch) prog.pin = FILTERED_PIN;
+    if (!pinpoller_program_init(prog)) {
+        pio_sm_unclaim(prog.pio, prog.sm);
+        return false;
+    }
+    if (deglitch) {
+        filter.sm = pio_claim_unused_sm(pio0, true);
+        deglitch_filter_init(filter);
+    }
+
+    channel_rx = init_getter_dma(buf, BUF_WORDS, prog);
+    init_getter_irq(channel_rx);
+    // the setter reads the payload for as long as the capture runs
+    static uint32_t payload;
+    payload = pinpoller_format(prog)->tx_payload;
+    init_setter_dma(&payload, prog);
+
+    sm_mask = 1u << prog.sm;
+    if (deglitch) sm_mask |= 1u << filter.sm;
+
+    pinpoller_clear_fifo(prog);
+    if (mode == MODE_MEASURE) {
+        start_measurement();
+    } else if (mode == MODE_STREAM) {
+        start_stream();
+    } else if (mode == MODE_PREVIEW) {
+        start_preview();
+    } else {
+        sched_register(SCHED_EVENT_CAPTURE_BLOCK, capture_done);
+        dma_channel_start(channel_rx);
+        pio_set_sm_mask_enabled(prog.pio, sm_mask, true);
+    }
+    return true;
+}
+
+// parameters from the host are checked against the generated formats before
+// anything uses them. a bad one is dropped, the mode and the last good value stay
+static bool rle_width_valid(long bits) {
+    return bits > 0 && bits <= UINT8_MAX && capture_format_find(CAPTURE_ENCODING_RLE, 1, (uint8_t)bits) != NULL;
+}
+
+static bool raw_channels_valid(long channels) {
+    return channels > 0 && channels <= UINT8_MAX && capture_format_find(CAPTURE_ENCODING_RAW, (uint8_t)channels, 0) != NULL;
+}
+
+static bool clkdiv_valid(long clkdiv) {
+    return clkdiv >= 1 && clkdiv <= UINT16_MAX;
+}
+
+static bool measure_interval_valid(long ms) {
+    return ms >= 1 && ms <= UINT16_MAX;
+}
+
+// 0 turns deglitching off, the pio program needs at least 2
+static bool glitch_threshold_valid(long threshold) {
+    return threshold == 0 || (threshold >= 2 && threshold <= GLITCH_THRESHOLD_MAX);
+}
+
+static void on_command(void) {
+    // ep1 naks until it is armed again, nothing writes cmd in the meantime
+    char line[sizeof(cmd)];
+    memcpy(line, cmd, sizeof(cmd));
+    usb_ep1_out_ready();
+
+    capture_mode next = MODE_IDLE;
+    if (strcmp(line, "start") == 0) next = MODE_CAPTURE;
+    else if (strncmp(line, "deglitch ", 9) == 0) {
+        long threshold = strtol(line + 9, NULL, 10);
+        if (glitch_threshold_valid(threshold)) glitch_threshold = threshold;
+    }
+    else if (strncmp(line, "width ", 6) == 0) {
+        long bits = strtol(line + 6, NULL, 10);
+        if (rle_width_valid(bits)) counter_bits = bits;
+    }
+    else if (strncmp(line, "lanes ", 6) == 0) lanes = atoi(line + 6);
+    else if (strcmp(line, "stream") == 0) next = MODE_STREAM;
+    else if (strncmp(line, "multi ", 6) == 0) {
+        // "multi <clkdiv>" or "multi <clkdiv> <channels>"
+        char *end;
+        long clkdiv = strtol(line + 6, &end, 10);
+        long channels = (*end == ' ') ? strtol(end + 1, NULL, 10) : multi_channels;
+        if (!clkdiv_valid(clkdiv) || !raw_channels_valid(channels)) return;
+        multi_clkdiv = clkdiv;
+        multi_channels = channels;
+        next = MODE_MULTI;
+    }
+    else if (strncmp(line, "measure ", 8) == 0) {
+        long interval_ms = strtol(line + 8, NULL, 10);
+        if (!measure_interval_valid(interval_ms)) return;
+        measure_interval_ms = interval_ms;
+        next = MODE_MEASURE;
+    }
+    else if (strncmp(line, "preview ", 8) == 0) {
+        // "preview <bucket samples>" for the pinpoller or
+        // "preview <bucket samples> <clkdiv> <channels>" for the pin sampler
+        char *end;
+        long bucket_samples = strtol(line + 8, &end, 10);
+        bool sampled = *end == ' ';
+        long clkdiv = multi_clkdiv;
+        long channels = multi_channels;
+        if (sampled) {
+            clkdiv = strtol(end + 1, &end, 10);
+            if (*end == ' ') channels = strtol(end + 1, NULL, 10);
+        }
+        if (bucket_samples <= 0) return;
+        if (sampled && (!clkdiv_valid(clkdiv) || !raw_channels_valid(channels))) return;
+        preview_bucket_samples = bucket_samples;
+        preview_sampled = sampled;
+        multi_clkdiv = clkdiv;
+        multi_channels = channels;
+        next = MODE_PREVIEW;
+    }
+    else if (strncmp(line, "fetch ", 6) == 0 && mode == MODE_PREVIEW) {
+        // "fetch <first block> <count>", replaces any fetch still going on
+        char *end;
+        uint32_t first = strtoul(line + 6, &end, 10);
+        uint32_t count = strtoul(end, NULL, 10);
+        fetch_next = first;
+        fetch_end = first + count;
+        fetch_service();
+    }
+    // one capture per boot, the pio and dma are not torn down again
+    if (next == MODE_IDLE || mode != MODE_IDLE) return;
+    mode = next;
+    bool started;
+    if (mode == MODE_MULTI) started = start_multi();
+    else if (mode == MODE_PREVIEW && preview_sampled) {
+        started = start_sampler();
+        if (started) start_preview();
+    }
+    else started = start_poller();
+    // no program for the format, nothing was claimed or started
+    if (!started) mode = MODE_IDLE;
+}
+
+int main() {
+    stdio_init_all();
+    stats_init();
+    sched_init();
+    sched_register(SCHED_EVENT_EP1_OUT, on_command);
+    usb_init();
+    usb_register_ep1_out_func(ep1_func);
+
+    // everything from here on runs from events
+    sched_run();
+}
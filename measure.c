@@ -0,0 +1,85 @@
+#include "pico/stdlib.h"
+#include <string.h>
+
+#include "measure.h"
+#include "rle_stream.h"
+
+// statistics of the interval in progress, the record itself is packed so
+// keep the running values in a normally aligned struct
+typedef struct {
+    uint32_t edges;
+    uint32_t period_min;
+    uint32_t period_max;
+    uint64_t period_sum;
+    uint32_t periods;
+    uint32_t high_samples;
+    uint32_t total_samples;
+    uint16_t high_hist[MEASURE_HIST_BUCKETS];
+    uint16_t low_hist[MEASURE_HIST_BUCKETS];
+} measure_window;
+
+static rle_decoder decoder;
+static measure_window window;
+static uint16_t interval = 0;
+static uint32_t last_high = 0; // width of the last high pulse, 0 until one was seen
+static uint8_t seq = 0;
+
+static void measure_reset_window(void) {
+    memset(&window, 0, sizeof(window));
+    window.period_min = UINT32_MAX;
+}
+
+static void measure_hist_add(uint16_t *hist, uint32_t samples) {
+    uint8_t bucket = (samples == 0) ? 0 : (31 - __builtin_clz(samples));
+    if (bucket >= MEASURE_HIST_BUCKETS) bucket = MEASURE_HIST_BUCKETS - 1;
+    if (hist[bucket] != UINT16_MAX) hist[bucket]++; // saturate instead of wrapping
+}
+
+static void measure_run(uint8_t level, uint32_t samples, void *ctx) {
+    window.edges++;
+    window.total_samples += samples;
+    if (level) {
+        window.high_samples += samples;
+        measure_hist_add(window.high_hist, samples);
+        last_high = samples;
+        return;
+    }
+    measure_hist_add(window.low_hist, samples);
+    // a low pulse after a high one closes a period
+    if (last_high == 0) return;
+    uint32_t period = last_high + samples;
+    window.periods++;
+    window.period_sum += period;
+    if (period < window.period_min) window.period_min = period;
+    if (period > window.period_max) window.period_max = period;
+}
+
+// false for a counter width rle_stream does not decode
+bool measure_init(uint16_t interval_ms, uint8_t counter_bits) {
+    if (!rle_decoder_init_width(&decoder, counter_bits)) return false;
+    measure_reset_window();
+    interval = interval_ms;
+    last_high = 0;
+    seq = 0;
+    return true;
+}
+
+void measure_feed(const uint8_t *data, uint32_t len) {
+    rle_decoder_feed(&decoder, data, len, measure_run, NULL);
+}
+
+void measure_take_record(measure_record *rec) {
+    rec->type = MEASURE_RECORD_TYPE;
+    rec->seq = seq++;
+    rec->interval_ms = interval;
+    rec->edges = window.edges;
+    rec->period_min = window.periods ? window.period_min : 0;
+    rec->period_max = window.period_max;
+    rec->period_mean = window.periods ? (window.period_sum / window.periods) : 0;
+    rec->periods = window.periods;
+    rec->high_samples = window.high_samples;
+    rec->total_samples = window.total_samples;
+    memcpy(rec->high_hist, window.high_hist, sizeof(window.high_hist));
+    memcpy(rec->low_hist, window.low_hist, sizeof(window.low_hist));
+    measure_reset_window();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "pico/stdlib.h"
+
+#define MEASURE_RECORD_TYPE 0x4d // 'M'
+#define MEASURE_HIST_BUCKETS 8
+
+// summary of one interval, fits a single ep2 packet.
+// all times are in pinpoller samples, duty cycle is high_samples / total_samples
+typedef struct {
+    uint8_t type; // MEASURE_RECORD_TYPE
+    uint8_t seq; // increments per record so the host sees dropped ones
+    uint16_t interval_ms; // configured interval
+    uint32_t edges; // level changes seen in the interval
+    uint32_t period_min; // rising edge to rising edge
+    uint32_t period_max;
+    uint32_t period_mean;
+    uint32_t periods; // number of full periods seen
+    uint32_t high_samples;
+    uint32_t total_samples;
+    uint16_t high_hist[MEASURE_HIST_BUCKETS]; // high pulse widths, bucket n holds [2^n, 2^(n+1))
+    uint16_t low_hist[MEASURE_HIST_BUCKETS]; // same for low pulses
+} __packed measure_record;
+
+bool measure_init(uint16_t interval_ms, uint8_t counter_bits);
+void measure_feed(const uint8_t *data, uint32_t len);
+void measure_take_record(measure_record *rec);
@@ -3,21 +3,58 @@
 #include "pinpoller.pio.h"
 #include "stdio.h"
 #include "pinpoller.h"
+#include "capture_family.h"
 
 
-void pinpoller_program_init(poller_program prog) {
-    pio_sm_set_enabled(prog.pio, prog.sm, false);
-    uint offset = pio_add_program(prog.pio, &pinpoller_program);
-    pio_sm_config c = pinpoller_program_get_default_config(offset);
-    sm_config_set_jmp_pin(&c, prog.pin);
-    sm_config_set_clkdiv_int_frac(&c, prog.poll_rate, 0);
-    sm_config_set_in_shift(&c, true, true, 32); // autopush enable shift right
-    sm_config_set_out_shift(&c, true, true, 32); // autopull enable shift right
+const capture_format *pinpoller_format(poller_program prog) {
+    return capture_format_find(CAPTURE_ENCODING_RLE, 1, prog.counter_bits);
+}
 
-    pio_sm_init(prog.pio, prog.sm, offset + pinpoller_offset_start, &c);
+bool pinpoller_program_init(poller_program prog) {
+    return capture_program_init(pinpoller_format(prog), prog.pin, prog.pio, prog.sm, prog.poll_rate);
 }
 
 void pinpoller_clear_fifo(poller_program prog) {
     pio_sm_clear_fifos(prog.pio, prog.sm);
     
 }
+
+bool pinpoller_rx_stalled(PIO pio, uint sm) {
+    // sticky flag set when the sm tried to push into a full rx fifo
+    uint32_t stall_bit = 1u << (PIO_FDEBUG_RXSTALL_LSB + sm);
+    bool stalled = pio->fdebug & stall_bit;
+    pio->fdebug = stall_bit; // write 1 to clear
+    return stalled;
+}
+
+void deglitch_filter_init(deglitch_filter prog) {
+    if (prog.threshold < 2) assert(0 && "deglitch threshold has to be at least 2 samples");
+    pio_sm_set_enabled(prog.pio, prog.sm, false);
+    uint offset = pio_add_program(prog.pio, &deglitch_program);
+    pio_sm_config c = deglitch_program_get_default_config(offset);
+    sm_config_set_jmp_pin(&c, prog.pin);
+    sm_config_set_set_pins(&c, prog.out_pin, 1);
+    sm_config_set_clkdiv_int_frac(&c, prog.poll_rate, 0); // same sample period as pinpoller
+    pio_gpio_init(prog.pio, prog.out_pin);
+    pio_sm_set_consecutive_pindirs(prog.pio, prog.sm, prog.out_pin, 1, true);
+
+    pio_sm_init(prog.pio, prog.sm, offset + deglitch_offset_start, &c);
+    // the first sample is taken before the confirm loop and the loop runs y+1 times
+    pio_sm_put(prog.pio, prog.sm, prog.threshold - 2);
+}
+
+uint32_t deglitch_filter_glitches(deglitch_filter prog) {
+    // x counts down from all ones, copy ~x out through the rx fifo.
+    // each exec holds the sm for a cycle so dont poll this in a tight loop
+    pio_sm_exec(prog.pio, prog.sm, pio_encode_mov_not(pio_isr, pio_x));
+    pio_sm_exec(prog.pio, prog.sm, pio_encode_push(false, false));
+    return pio_sm_get_blocking(prog.pio, prog.sm);
+}
+
+const capture_format *pinsampler_format(sampler_program prog) {
+    return capture_format_find(CAPTURE_ENCODING_RAW, prog.channels, 0);
+}
+
+bool pinsampler_program_init(sampler_program prog) {
+    return capture_program_init(pinsampler_format(prog), prog.base_pin, prog.pio, prog.sm, prog.clkdiv);
+}
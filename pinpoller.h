@@ -2,6 +2,7 @@
 
 #include "hardware/pio.h"
 #include "hardware/pio.h"
+#include "capture_formats.h"
 
 typedef enum {
     SR_125MHZ = 1,
@@ -14,8 +15,34 @@ typedef struct {
     PIO pio;                // pio to use
     uint sm;                // statemachine to use
     sample_rates poll_rate; // poll rate to use
+    uint8_t counter_bits;   // run length counter width, one of the generated formats
 } poller_program;
 
+typedef struct {
+    uint pin;               // raw pin to filter
+    uint out_pin;           // spare pin the filtered level is driven on, poll this one
+    uint threshold;         // pulses shorter than this many samples are dropped, at least 2
+    PIO pio;                // pio to use
+    uint sm;                // statemachine to use
+    sample_rates poll_rate; // has to match the pinpoller poll rate
+} deglitch_filter;
+
+typedef struct {
+    uint base_pin;          // first of the consecutive pins
+    PIO pio;                // pio to use
+    uint sm;                // statemachine to use
+    uint16_t clkdiv;        // one sample of all pins per clkdiv system clocks
+    uint8_t channels;       // pins per sample, one of the generated formats
+} sampler_program;
+
 
-void pinpoller_program_init(poller_program prog);
+const capture_format *pinpoller_format(poller_program prog);
+bool pinpoller_program_init(poller_program prog);
 void pinpoller_clear_fifo(poller_program prog);
+bool pinpoller_rx_stalled(PIO pio, uint sm);
+
+void deglitch_filter_init(deglitch_filter prog);
+uint32_t deglitch_filter_glitches(deglitch_filter prog);
+
+const capture_format *pinsampler_format(sampler_program prog);
+bool pinsampler_program_init(sampler_program prog);
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "preview.h"
+
+// counter_bits 0 means raw samples of channels pins each, anything else is
+// single pin pinpoller output with that counter width. false for a width
+// rle_stream does not decode
+bool preview_init(preview *p, uint32_t bucket_samples, uint8_t channels, uint8_t counter_bits,
+    preview_record_func on_record, void *ctx) {
+    p->bucket_samples = bucket_samples ? bucket_samples : 1;
+    p->rle = counter_bits != 0;
+    p->channels = p->rle ? 1 : channels;
+    if (p->rle && !rle_decoder_init_width(&p->dec, counter_bits)) return false;
+    p->open_done = 0;
+    p->last = 0;
+    p->have_last = false;
+    p->block = 0;
+    p->in_bucket = 0;
+    p->filled = 0;
+    memset(&p->rec, 0, sizeof(p->rec));
+    p->rec.bucket_samples = p->bucket_samples;
+    p->on_record = on_record;
+    p->ctx = ctx;
+    return true;
+}
+
+static void preview_close_bucket(preview *p) {
+    p->in_bucket = 0;
+    p->filled++;
+    p->rec.block_last = p->block;
+    if (p->filled < PREVIEW_BUCKETS) return;
+    p->on_record(&p->rec, p->ctx);
+    p->rec.first_bucket += PREVIEW_BUCKETS;
+    p->filled = 0;
+}
+
+// samples samples of value, in order
+static void preview_add(preview *p, uint16_t value, uint32_t samples) {
+    if (samples == 0) return;
+    bool edge = p->have_last && value != p->last;
+    p->last = value;
+    p->have_last = true;
+    while (samples) {
+        preview_bucket *bucket = &p->rec.buckets[p->filled];
+        if (p->in_bucket == 0) {
+            if (p->filled == 0) p->rec.block_first = p->block;
+            *bucket = (preview_bucket){0xffff, 0, 0};
+        }
+        if (edge && bucket->transitions != 0xffff) bucket->transitions++;
+        edge = false;
+        bucket->all_high &= value;
+        bucket->any_high |= value;
+        uint32_t n = p->bucket_samples - p->in_bucket;
+        if (n > samples) n = samples;
+        p->in_bucket += n;
+        samples -= n;
+        if (p->in_bucket == p->bucket_samples) preview_close_bucket(p);
+    }
+}
+
+static void preview_run(uint8_t level, uint32_t samples, void *ctx) {
+    preview *p = ctx;
+    // the start of this run may already be in the buckets, see preview_feed
+    preview_add(p, level, samples - p->open_done);
+    p->open_done = 0;
+}
+
+static uint16_t preview_sample(const preview *p, const uint8_t *data, uint32_t i) {
+    // autopush shifts right, so sample i sits at bit i * channels
+    uint32_t bit = i * p->channels;
+    if (p->channels == 16) return data[bit >> 3] | (data[(bit >> 3) + 1] << 8);
+    return (data[bit >> 3] >> (bit & 7)) & ((1u << p->channels) - 1);
+}
+
+void preview_feed(preview *p, uint32_t block, const uint8_t *data, uint32_t len) {
+    p->block = block;
+    if (p->rle) {
+        rle_decoder_feed(&p->dec, data, len, preview_run, p);
+        // a level that does not change would hold the preview back forever,
+        // count what the unfinished run has so far and only add the rest later
+        preview_add(p, p->dec.level, p->dec.run - p->open_done);
+        p->open_done = p->dec.run;
+        return;
+    }
+
+    uint32_t samples = (len * 8) / p->channels;
+    uint32_t i = 0;
+    while (i < samples) {
+        uint16_t value = preview_sample(p, data, i);
+        uint32_t n = 1;
+        while (i + n < samples && preview_sample(p, data, i + n) == value) n++;
+        preview_add(p, value, n);
+        i += n;
+    }
+}
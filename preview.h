@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rle_stream.h"
+
+// low rate summary of a capture for live viewing. plain C like rle_stream.c
+// so the host can rebuild previews from fetched full resolution data too.
+//
+// the capture is cut into buckets of bucket_samples samples. every bucket
+// keeps the and and the or of all its samples (a channel with its bit set in
+// all_high never went low, one clear in any_high never went high) and how
+// many times the sample value changed. buckets go out PREVIEW_BUCKETS at a
+// time as one preview_record.
+
+#define PREVIEW_BUCKETS 16
+
+typedef struct {
+    uint16_t all_high; // and of every sample in the bucket
+    uint16_t any_high; // or of every sample in the bucket
+    uint16_t transitions; // sample value changes, sticks at 0xffff
+} __attribute__((packed)) preview_bucket;
+
+// block_first and block_last are the capture blocks (stream_frame seq) the
+// buckets were summarized from. rle runs are only known once they end, so
+// fetch a block either side to be sure to cover the buckets
+typedef struct {
+    uint32_t first_bucket; // index of buckets[0] since the capture started
+    uint32_t bucket_samples;
+    uint32_t block_first;
+    uint32_t block_last;
+    preview_bucket buckets[PREVIEW_BUCKETS];
+} __attribute__((packed)) preview_record;
+
+typedef void (*preview_record_func)(const preview_record *rec, void *ctx);
+
+typedef struct {
+    uint32_t bucket_samples;
+    uint8_t channels; // 1 for rle data
+    bool rle; // data is pinpoller counters instead of packed samples
+    rle_decoder dec;
+    uint32_t open_done; // samples of the decoder's unfinished run already in buckets
+    uint16_t last; // value of the last sample
+    bool have_last;
+    uint32_t block; // capture block being fed
+    uint32_t in_bucket; // samples in the current bucket
+    uint8_t filled; // buckets done in rec
+    preview_record rec;
+    preview_record_func on_record;
+    void *ctx;
+} preview;
+
+bool preview_init(preview *p, uint32_t bucket_samples, uint8_t channels, uint8_t counter_bits,
+    preview_record_func on_record, void *ctx);
+void preview_feed(preview *p, uint32_t block, const uint8_t *data, uint32_t len);
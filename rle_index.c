@@ -0,0 +1,76 @@
+#include "rle_index.h"
+
+typedef struct {
+    rle_span_func on_span;
+    void *ctx;
+    uint64_t start; // sample position of the next run
+} rle_index_spans;
+
+uint32_t rle_index_chunks(uint64_t len, uint32_t chunk_bytes) {
+    return (uint32_t)((len + chunk_bytes - 1) / chunk_bytes);
+}
+
+// false for a counter width rle_stream does not decode, or chunks that would
+// start in the middle of a counter
+bool rle_index_init(rle_index *idx, uint8_t counter_bits, const uint8_t *stream, uint64_t len, uint32_t chunk_bytes,
+    rle_checkpoint *checkpoints) {
+    if (!rle_unpack_init(&idx->unpack, counter_bits)) return false;
+    if (chunk_bytes == 0 || chunk_bytes % idx->unpack.unit_bytes) return false;
+    idx->counter_bits = counter_bits;
+    idx->stream = stream;
+    idx->len = len;
+    idx->chunk_bytes = chunk_bytes;
+    idx->chunks = rle_index_chunks(len, chunk_bytes);
+    idx->checkpoints = checkpoints;
+    idx->samples = 0;
+    return true;
+}
+
+static uint32_t rle_index_chunk_len(const rle_index *idx, uint32_t chunk) {
+    uint64_t offset = (uint64_t)chunk * idx->chunk_bytes;
+    uint64_t left = idx->len - offset;
+    return left < idx->chunk_bytes ? (uint32_t)left : idx->chunk_bytes;
+}
+
+// until rle_index_finish the checkpoint holds the chunk's own samples and
+// whether its last counter ran out
+void rle_index_scan(rle_index *idx, uint32_t chunk) {
+    rle_checkpoint *cp = &idx->checkpoints[chunk];
+    cp->byte_offset = (uint64_t)chunk * idx->chunk_bytes;
+    cp->position = rle_chunk_samples(&idx->unpack, idx->stream + cp->byte_offset,
+        rle_index_chunk_len(idx, chunk), &cp->saturated);
+}
+
+// every chunk has to be scanned
+void rle_index_finish(rle_index *idx) {
+    uint64_t position = 0;
+    bool saturated = false;
+    for (uint32_t i = 0; i < idx->chunks; i++) {
+        rle_checkpoint *cp = &idx->checkpoints[i];
+        uint64_t samples = cp->position;
+        bool ends_saturated = cp->saturated;
+        cp->position = position;
+        cp->saturated = saturated;
+        position += samples;
+        saturated = ends_saturated;
+    }
+    idx->samples = position;
+}
+
+static void rle_index_run(uint8_t level, uint32_t samples, void *ctx) {
+    rle_index_spans *spans = ctx;
+    // a chunk that starts on the filler after a saturated count hands out an empty run first
+    if (samples) spans->on_span(level, spans->start, samples, spans->ctx);
+    spans->start += samples;
+}
+
+// hands out the runs of one chunk with their absolute start, the run still
+// open at the end of the chunk included
+void rle_index_decode(const rle_index *idx, uint32_t chunk, rle_span_func on_span, void *ctx) {
+    const rle_checkpoint *cp = &idx->checkpoints[chunk];
+    rle_decoder dec;
+    rle_decoder_init_at(&dec, idx->counter_bits, cp);
+    rle_index_spans spans = {on_span, ctx, cp->position};
+    rle_decoder_feed(&dec, idx->stream + cp->byte_offset, rle_index_chunk_len(idx, chunk), rle_index_run, &spans);
+    if (dec.run) on_span(dec.level, spans.start, dec.run, ctx);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rle_stream.h"
+
+// checkpoints for a run length stream held in memory, so turning it into
+// absolute sample positions is no longer one serial pass. plain C like
+// rle_stream.c, the host side builds it too.
+//
+// the stream is cut into chunks of chunk_bytes. rle_index_scan sums the
+// samples of one chunk, chunks can be scanned in any order and by any number
+// of threads. rle_index_finish then turns the sums into checkpoints (a prefix
+// sum over the chunks, cheap next to the scan) and from there on every chunk
+// decodes on its own with rle_index_decode. handing chunks out from a shared
+// counter keeps every thread busy however the runs are spread.
+//
+// a run that crosses into the next chunk comes out as two spans of the same
+// level, whoever puts the chunks back together joins them.
+
+#define RLE_INDEX_CHUNK_BYTES 4096
+
+typedef void (*rle_span_func)(uint8_t level, uint64_t start, uint32_t samples, void *ctx);
+
+typedef struct {
+    uint8_t counter_bits;
+    rle_unpack unpack;
+    const uint8_t *stream;
+    uint64_t len;
+    uint32_t chunk_bytes; // whole counters, a multiple of unpack.unit_bytes
+    uint32_t chunks;
+    rle_checkpoint *checkpoints; // one per chunk, rle_index_chunks of them
+    uint64_t samples; // whole stream, set by rle_index_finish
+} rle_index;
+
+uint32_t rle_index_chunks(uint64_t len, uint32_t chunk_bytes);
+bool rle_index_init(rle_index *idx, uint8_t counter_bits, const uint8_t *stream, uint64_t len, uint32_t chunk_bytes,
+    rle_checkpoint *checkpoints);
+void rle_index_scan(rle_index *idx, uint32_t chunk);
+void rle_index_finish(rle_index *idx);
+void rle_index_decode(const rle_index *idx, uint32_t chunk, rle_span_func on_span, void *ctx);
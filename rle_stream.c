@@ -0,0 +1,123 @@
+#include "rle_stream.h"
+
+#if !CAPTURE_UNITS_LSB_FIRST
+#error "rle_stream unpacks counters lowest bits first, see capture_formats.h"
+#endif
+
+// false for widths the firmware has no program for, or too wide for the decoder
+bool rle_unpack_init(rle_unpack *unpack, uint8_t counter_bits) {
+    const capture_format *format = capture_format_find(CAPTURE_ENCODING_RLE, 1, counter_bits);
+    if (format == NULL || counter_bits > 16) return false;
+    unpack->counter_bits = format->counter_bits;
+    unpack->units_per_byte = format->units_per_byte;
+    unpack->unit_bytes = format->unit_bytes;
+    return true;
+}
+
+bool rle_decoder_init(rle_decoder *dec) {
+    return rle_decoder_init_width(dec, RLE_DEFAULT_COUNTER_BITS);
+}
+
+bool rle_decoder_init_width(rle_decoder *dec, uint8_t counter_bits) {
+    if (!rle_unpack_init(&dec->unpack, counter_bits)) return false;
+    dec->saturated_count = (uint16_t)((1u << counter_bits) - 1);
+    dec->counter_start = dec->saturated_count - 1;
+    dec->partial = 0;
+    dec->partial_bytes = 0;
+    // pinpoller starts in the low loop
+    dec->level = 0;
+    dec->next_level = 0;
+    dec->saturated = false;
+    dec->run = 0;
+    dec->position = 0;
+    return true;
+}
+
+// starts at a checkpoint instead of the start of the stream. the run the
+// chunk starts in may have begun in the chunk before, the first run handed
+// out is only its part from cp->position on
+bool rle_decoder_init_at(rle_decoder *dec, uint8_t counter_bits, const rle_checkpoint *cp) {
+    if (!rle_decoder_init_width(dec, counter_bits)) return false;
+    // levels alternate from the first counter on
+    uint64_t counters = (cp->byte_offset * dec->unpack.units_per_byte) / dec->unpack.unit_bytes;
+    dec->next_level = counters & 1u;
+    dec->level = dec->next_level;
+    dec->saturated = cp->saturated;
+    dec->position = cp->position;
+    return true;
+}
+
+static void rle_decoder_count(rle_decoder *dec, uint16_t value, rle_run_func on_run, void *ctx) {
+    uint8_t level = dec->next_level;
+    dec->next_level ^= 1u;
+    // a counter that ran out wrapped to all ones, that is the saturated count
+    uint16_t samples = (dec->counter_start - value) & dec->saturated_count;
+    dec->position += samples;
+
+    if (dec->saturated && samples == 0) {
+        // filler between two halves of a long run
+        dec->saturated = false;
+        return;
+    }
+    dec->saturated = (samples == dec->saturated_count);
+    if (level == dec->level) {
+        dec->run += samples;
+    } else {
+        on_run(dec->level, dec->run, ctx);
+        dec->level = level;
+        dec->run = samples;
+    }
+}
+
+void rle_decoder_feed(rle_decoder *dec, const uint8_t *data, uint32_t len, rle_run_func on_run, void *ctx) {
+    const rle_unpack *unpack = &dec->unpack;
+    for (uint32_t i = 0; i < len; i++) {
+        if (unpack->unit_bytes > 1) {
+            // counters can be split between feeds
+            dec->partial |= (uint32_t)data[i] << (8 * dec->partial_bytes);
+            if (++dec->partial_bytes < unpack->unit_bytes) continue;
+            rle_decoder_count(dec, (uint16_t)dec->partial, on_run, ctx);
+            dec->partial = 0;
+            dec->partial_bytes = 0;
+            continue;
+        }
+        uint32_t byte = data[i];
+        for (uint8_t u = 0; u < unpack->units_per_byte; u++) {
+            rle_decoder_count(dec, byte & dec->saturated_count, on_run, ctx);
+            byte >>= unpack->counter_bits;
+        }
+    }
+}
+
+// samples in a chunk without handing out runs, the fast first pass for
+// checkpoints. saturated tells if the last counter in the chunk ran out.
+// a counter cut off at the end of the chunk is left out
+uint64_t rle_chunk_samples(const rle_unpack *unpack, const uint8_t *data, uint32_t len, bool *saturated) {
+    uint32_t saturated_count = (1u << unpack->counter_bits) - 1;
+    uint32_t start = saturated_count - 1;
+    uint64_t samples = 0;
+    uint32_t last = 0;
+    if (unpack->unit_bytes > 1) {
+        for (uint32_t i = 0; i + unpack->unit_bytes <= len; i += unpack->unit_bytes) {
+            uint32_t value = 0;
+            for (uint8_t b = 0; b < unpack->unit_bytes; b++) value |= (uint32_t)data[i + b] << (8 * b);
+            last = (start - value) & saturated_count;
+            samples += last;
+        }
+    } else if (unpack->units_per_byte == 1) {
+        // one counter a byte, the common case, without the unit loop
+        for (uint32_t i = 0; i < len; i++) samples += (start - data[i]) & saturated_count;
+        if (len) last = (start - data[len - 1]) & saturated_count;
+    } else {
+        for (uint32_t i = 0; i < len; i++) {
+            uint32_t byte = data[i];
+            for (uint8_t u = 0; u < unpack->units_per_byte; u++) {
+                last = (start - (byte & saturated_count)) & saturated_count;
+                samples += last;
+                byte >>= unpack->counter_bits;
+            }
+        }
+    }
+    *saturated = last == saturated_count;
+    return samples;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "capture_formats.h"
+
+// decoder for the pinpoller run length stream. plain C with no sdk headers so
+// the host side can build it too.
+//
+// every byte is the value a pinpoller counter had when the pin changed, bytes
+// alternate between low and high runs starting with low. counters count down
+// from RLE_COUNT_START so a run is (RLE_COUNT_START - value) samples. a counter
+// that runs out is sent as RLE_COUNT_SATURATED samples followed by a zero run of
+// the other level, the decoder glues the halves back together.
+//
+// the counter width comes from the capture format (capture_formats.h), so do
+// the counters per byte and the bytes per counter. only widths in that table
+// decode, RLE_COUNT_* are the 8 bit values.
+
+#define RLE_COUNT_START 0xFE
+#define RLE_COUNT_SATURATED 0xFF
+#define RLE_DEFAULT_COUNTER_BITS 8
+
+typedef void (*rle_run_func)(uint8_t level, uint32_t samples, void *ctx);
+
+// where a chunk of the stream starts. the level of every counter follows from
+// its place in the stream, so this is all a decoder needs to start in the
+// middle (rle_index.h builds them)
+typedef struct {
+    uint64_t byte_offset; // chunk start in the stream, on a counter boundary
+    uint64_t position; // samples before the chunk
+    bool saturated; // the counter before the chunk ran out
+} rle_checkpoint;
+
+// how the counters of one width sit in the bytes, from the capture format table
+typedef struct {
+    uint8_t counter_bits;
+    uint8_t units_per_byte; // counters in a byte, lowest bits first
+    uint8_t unit_bytes; // bytes in a counter, little endian
+} rle_unpack;
+
+typedef struct {
+    rle_unpack unpack;
+    uint16_t counter_start; // all ones minus one for the width
+    uint16_t saturated_count; // all ones for the width
+    uint32_t partial; // low bytes of a counter split between feeds
+    uint8_t partial_bytes;
+    uint8_t level;      // level of the run being decoded
+    uint8_t next_level; // level of the next byte in the stream
+    bool saturated;     // last count ran out, expect a zero run of the other level
+    uint32_t run;       // samples in the current run so far
+    uint64_t position;  // samples decoded since init, including the current run
+} rle_decoder;
+
+bool rle_unpack_init(rle_unpack *unpack, uint8_t counter_bits);
+bool rle_decoder_init(rle_decoder *dec);
+bool rle_decoder_init_width(rle_decoder *dec, uint8_t counter_bits);
+bool rle_decoder_init_at(rle_decoder *dec, uint8_t counter_bits, const rle_checkpoint *cp);
+void rle_decoder_feed(rle_decoder *dec, const uint8_t *data, uint32_t len, rle_run_func on_run, void *ctx);
+uint64_t rle_chunk_samples(const rle_unpack *unpack, const uint8_t *data, uint32_t len, bool *saturated);
@@ -0,0 +1,146 @@
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "capture_formats.h"
+#include "capture_model.h"
+#include "signal_corpus.h"
+#include "rle_stream.h"
+#include "rle_index.h"
+#include <stdio.h>
+#include <string.h>
+
+// checkpointed rle decode benchmark. a synthetic capture of every rle format
+// is decoded into absolute sample positions once serially and then in chunks
+// from rle_index, with 1 and 2 cores taking chunks from a shared counter.
+// results are printed over uart as csv. host/rlebench.c does the same with
+// threads on captures too big for sram. build with -DBUILD_RLE_BENCH=ON
+
+#define BENCH_SEED 0x1a2b3c4d
+#define BENCH_RATE_HZ 62500000
+#define BENCH_BYTES (96 * 1024)
+#define BENCH_CHUNK_BYTES 1024
+#define BENCH_CHUNKS (BENCH_BYTES / BENCH_CHUNK_BYTES)
+#define BENCH_ROUNDS 8
+
+typedef struct {
+    uint64_t spans;
+    uint64_t high; // samples the pin was high, checked against the serial decode
+} bench_result;
+
+static uint8_t stream[BENCH_BYTES];
+static uint32_t stream_len = 0;
+static capture_model model;
+static rle_checkpoint checkpoints[BENCH_CHUNKS];
+static rle_index idx;
+static bench_result results[BENCH_CHUNKS];
+static spin_lock_t *chunk_lock;
+static volatile uint32_t next_chunk = 0;
+
+static void bench_collect(const uint8_t *data, uint32_t len, void *ctx) {
+    (void)ctx;
+    if (len > BENCH_BYTES - stream_len) len = BENCH_BYTES - stream_len;
+    memcpy(stream + stream_len, data, len);
+    stream_len += len;
+}
+
+static void bench_run(uint8_t level, uint32_t samples, void *ctx) {
+    bench_result *r = ctx;
+    r->spans++;
+    if (level) r->high += samples;
+}
+
+static void bench_span(uint8_t level, uint64_t start, uint32_t samples, void *ctx) {
+    (void)start;
+    bench_run(level, samples, ctx);
+}
+
+static uint32_t bench_take_chunk(void) {
+    uint32_t status = spin_lock_blocking(chunk_lock);
+    uint32_t chunk = next_chunk++;
+    spin_unlock(chunk_lock, status);
+    return chunk;
+}
+
+static void bench_pass(bool decode) {
+    uint32_t chunk;
+    while ((chunk = bench_take_chunk()) < idx.chunks) {
+        if (decode) rle_index_decode(&idx, chunk, bench_span, &results[chunk]);
+        else rle_index_scan(&idx, chunk);
+    }
+}
+
+// core1 runs the pass core0 pushes and pushes it back when it is out of chunks
+static void core1_worker(void) {
+    while (1) {
+        uint32_t decode = multicore_fifo_pop_blocking();
+        bench_pass(decode);
+        multicore_fifo_push_blocking(decode);
+    }
+}
+
+static void bench_parallel_pass(uint cores, bool decode) {
+    next_chunk = 0;
+    if (cores > 1) multicore_fifo_push_blocking(decode);
+    bench_pass(decode);
+    if (cores > 1) multicore_fifo_pop_blocking();
+}
+
+static void bench_format(const capture_format *format) {
+    stream_len = 0;
+    capture_model_init(&model, format, BENCH_RATE_HZ, bench_collect, NULL);
+    signal_gen gen;
+    signal_corpus_init(&gen, SIGNAL_JITTER, BENCH_SEED);
+    while (stream_len < BENCH_BYTES) {
+        signal_segment seg;
+        signal_corpus_next(&gen, &seg);
+        capture_model_feed(&model, seg.levels, seg.duration_ns);
+    }
+
+    // serial reference, one decoder over the whole capture
+    bench_result serial = {0};
+    uint32_t start = time_us_32();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        serial = (bench_result){0};
+        rle_decoder dec;
+        rle_decoder_init_width(&dec, format->counter_bits);
+        rle_decoder_feed(&dec, stream, stream_len, bench_run, &serial);
+        bench_run(dec.level, dec.run, &serial);
+    }
+    uint32_t serial_us = time_us_32() - start;
+    printf("%u,%u,serial,1,%lu,%lu,%.0f,1.00,ok\n", format->id, format->counter_bits, stream_len, serial_us,
+        ((double)stream_len * BENCH_ROUNDS * 1000000.0) / serial_us);
+
+    for (uint cores = 1; cores <= 2; cores++) {
+        bench_result total = {0};
+        start = time_us_32();
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            memset(results, 0, sizeof(results));
+            rle_index_init(&idx, format->counter_bits, stream, stream_len, BENCH_CHUNK_BYTES, checkpoints);
+            bench_parallel_pass(cores, false);
+            rle_index_finish(&idx);
+            bench_parallel_pass(cores, true);
+        }
+        uint32_t us = time_us_32() - start;
+        for (uint32_t i = 0; i < idx.chunks; i++) total.high += results[i].high;
+        // spans split at chunk edges, only the high time has to match exactly
+        printf("%u,%u,chunked,%u,%lu,%lu,%.0f,%.2f,%s\n", format->id, format->counter_bits, cores, stream_len, us,
+            ((double)stream_len * BENCH_ROUNDS * 1000000.0) / us, (double)serial_us / us,
+            total.high == serial.high ? "ok" : "mismatch");
+    }
+}
+
+int main() {
+    stdio_init_all();
+    sleep_ms(2000); // time to open the uart
+    chunk_lock = spin_lock_init(spin_lock_claim_unused(true));
+    multicore_launch_core1(core1_worker);
+
+    printf("# rlebench seed 0x%08x rate %u Hz chunk %u bytes\n", BENCH_SEED, BENCH_RATE_HZ, BENCH_CHUNK_BYTES);
+    printf("format,counter_bits,decode,cores,bytes,us,bytes_per_s,speedup,check\n");
+    for (int f = 0; f < CAPTURE_FORMAT_COUNT; f++) {
+        if (capture_formats[f].encoding == CAPTURE_ENCODING_RLE) bench_format(&capture_formats[f]);
+    }
+    printf("# done\n");
+
+    while (1) tight_loop_contents();
+}
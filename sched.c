@@ -0,0 +1,53 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "sched.h"
+#include "stats.h"
+#include "hot_path.h"
+
+// one bit per event, bit number is the priority
+static volatile uint32_t pending = 0;
+static uint32_t posted_at[SCHED_EVENT_COUNT]; // cycle count at the first post since the last dispatch
+static sched_handler handlers[SCHED_EVENT_COUNT];
+
+void sched_init(void) {
+    pending = 0;
+    for (int i = 0; i < SCHED_EVENT_COUNT; i++) handlers[i] = NULL;
+}
+
+void sched_register(sched_event event, sched_handler handler) {
+    handlers[event] = handler;
+}
+
+// safe from irqs, posting an event that is already pending does nothing
+void HOT_PATH_FUNC(sched_post)(sched_event event) {
+    uint32_t status = save_and_disable_interrupts();
+    if (!(pending & (1u << event))) posted_at[event] = stats_cycles();
+    pending |= 1u << event;
+    restore_interrupts(status);
+    // wakes sched_run even if it is just about to wfe
+    __sev();
+}
+
+// never returns
+void sched_run(void) {
+    while (1) {
+        uint32_t status = save_and_disable_interrupts();
+        uint32_t ready = pending;
+        if (ready == 0) {
+            restore_interrupts(status);
+            // a post between the check and here left the event flag set, wfe falls through
+            uint32_t start = time_us_32();
+            __wfe();
+            stats_sched_idle(time_us_32() - start);
+            continue;
+        }
+        sched_event event = __builtin_ctz(ready);
+        pending = ready & ~(1u << event);
+        uint32_t latency = stats_cycles_elapsed(posted_at[event]);
+        restore_interrupts(status);
+
+        stats_sched_dispatch(event, latency);
+        if (handlers[event] != NULL) handlers[event]();
+    }
+}
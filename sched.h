@@ -0,0 +1,24 @@
+#pragma once
+
+#include "pico/stdlib.h"
+
+// run to completion event scheduler for core0. irqs only post events, the
+// handlers run from sched_run one at a time, lowest event number first.
+// with nothing pending the core sits in wfe, the time spent there shows up
+// in the stats.
+
+typedef enum {
+    SCHED_EVENT_CAPTURE_BLOCK, // getter dma finished a block, re-arm before the pio fifo fills
+    SCHED_EVENT_EP2_DONE, // ep2 finished a packet, buffers waiting on the host may be free
+    SCHED_EVENT_CODEC_DONE, // core1 finished encoding a block
+    SCHED_EVENT_EP1_OUT, // a command came in on ep1
+    SCHED_EVENT_USB_CONFIGURED, // host set the configuration
+    SCHED_EVENT_COUNT,
+} sched_event;
+
+typedef void (*sched_handler)(void);
+
+void sched_init(void);
+void sched_register(sched_event event, sched_handler handler);
+void sched_post(sched_event event);
+void sched_run(void);
@@ -0,0 +1,147 @@
+#include "signal_corpus.h"
+
+#define PWM_PERIOD_NS 100000
+#define UART_BIT_NS 8681 // 115200 baud
+#define SPI_HALF_NS 500
+#define SPI_BYTES 4
+#define I2C_HALF_NS 5000
+#define I2C_BYTES 3
+#define CLOCK_HALF_NS 62 // 8 MHz
+#define CLOCK_FRAMES 8 // 32 cycles per frame
+
+#define SPI_CS (1u << 2)
+#define SPI_SCK (1u << 1)
+#define I2C_SCL (1u << 1)
+
+static const char *names[SIGNAL_COUNT] = {
+    "pwm10", "pwm50", "pwm90", "uart", "spi", "i2c", "jitter", "idle", "clock_burst",
+};
+
+static uint32_t signal_rand(signal_gen *gen) {
+    // xorshift32, good enough for waveforms and the same everywhere
+    uint32_t x = gen->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gen->rng = x;
+    return x;
+}
+
+static void signal_add(signal_gen *gen, uint8_t levels, uint32_t duration_ns) {
+    if (duration_ns == 0) return;
+    gen->frame[gen->count++] = (signal_segment){levels, duration_ns};
+}
+
+static void signal_fill_pwm(signal_gen *gen, uint32_t duty_percent) {
+    uint32_t high = (PWM_PERIOD_NS / 100) * duty_percent;
+    signal_add(gen, 1, high);
+    signal_add(gen, 0, PWM_PERIOD_NS - high);
+}
+
+static void signal_fill_uart(signal_gen *gen) {
+    uint8_t byte = signal_rand(gen);
+    signal_add(gen, 1, (signal_rand(gen) % 20) * UART_BIT_NS); // idle line is high
+    signal_add(gen, 0, UART_BIT_NS); // start bit
+    for (int i = 0; i < 8; i++) signal_add(gen, (byte >> i) & 1u, UART_BIT_NS);
+    signal_add(gen, 1, UART_BIT_NS); // stop bit
+}
+
+static void signal_fill_spi(signal_gen *gen) {
+    signal_add(gen, SPI_CS, 1000 + (signal_rand(gen) % 49000));
+    for (int b = 0; b < SPI_BYTES; b++) {
+        uint8_t byte = signal_rand(gen);
+        for (int i = 7; i >= 0; i--) {
+            uint8_t mosi = (byte >> i) & 1u;
+            signal_add(gen, mosi, SPI_HALF_NS);
+            signal_add(gen, mosi | SPI_SCK, SPI_HALF_NS);
+        }
+    }
+}
+
+static void signal_fill_i2c(signal_gen *gen) {
+    signal_add(gen, 1 | I2C_SCL, 20000 + (signal_rand(gen) % 180000));
+    signal_add(gen, I2C_SCL, I2C_HALF_NS); // start, sda falls while scl is high
+    for (int b = 0; b < I2C_BYTES; b++) {
+        // 8 data bits and the ack, the device always acks
+        uint16_t bits = (uint16_t)((signal_rand(gen) & 0xffu) << 1);
+        for (int i = 8; i >= 0; i--) {
+            uint8_t sda = (bits >> i) & 1u;
+            signal_add(gen, sda, I2C_HALF_NS);
+            signal_add(gen, sda | I2C_SCL, I2C_HALF_NS);
+        }
+    }
+    signal_add(gen, 0, I2C_HALF_NS);
+    signal_add(gen, I2C_SCL, I2C_HALF_NS); // stop, sda rises in the next idle
+}
+
+static void signal_fill_clock_burst(signal_gen *gen) {
+    if (gen->phase == CLOCK_FRAMES) {
+        signal_add(gen, 0, 100000 + (signal_rand(gen) % 900000));
+        gen->phase = 0;
+        return;
+    }
+    for (int i = 0; i < 32; i++) {
+        signal_add(gen, 1, CLOCK_HALF_NS);
+        signal_add(gen, 0, CLOCK_HALF_NS);
+    }
+    gen->phase++;
+}
+
+static void signal_fill(signal_gen *gen) {
+    gen->count = 0;
+    gen->pos = 0;
+    switch (gen->kind) {
+    case SIGNAL_PWM_10:
+        signal_fill_pwm(gen, 10);
+        break;
+    case SIGNAL_PWM_50:
+        signal_fill_pwm(gen, 50);
+        break;
+    case SIGNAL_PWM_90:
+        signal_fill_pwm(gen, 90);
+        break;
+    case SIGNAL_UART:
+        signal_fill_uart(gen);
+        break;
+    case SIGNAL_SPI:
+        signal_fill_spi(gen);
+        break;
+    case SIGNAL_I2C:
+        signal_fill_i2c(gen);
+        break;
+    case SIGNAL_JITTER:
+        gen->phase ^= 1u;
+        signal_add(gen, gen->phase, 50 + (signal_rand(gen) % 4950));
+        break;
+    case SIGNAL_IDLE:
+        signal_add(gen, 0, 1000000 + (signal_rand(gen) % 9000000));
+        signal_add(gen, 1, 1000);
+        break;
+    case SIGNAL_CLOCK_BURST:
+        signal_fill_clock_burst(gen);
+        break;
+    default:
+        signal_add(gen, 0, 1000000);
+        break;
+    }
+}
+
+void signal_corpus_init(signal_gen *gen, signal_kind kind, uint32_t seed) {
+    gen->kind = kind;
+    // every kind gets its own sequence from the same seed, xorshift needs a non zero state
+    gen->rng = seed ^ ((kind + 1) * 0x9e3779b9u);
+    if (gen->rng == 0) gen->rng = 1;
+    gen->phase = 0;
+    gen->count = 0;
+    gen->pos = 0;
+}
+
+void signal_corpus_next(signal_gen *gen, signal_segment *seg) {
+    while (gen->pos >= gen->count) signal_fill(gen);
+    *seg = gen->frame[gen->pos++];
+}
+
+const char *signal_corpus_name(signal_kind kind) {
+    if (kind >= SIGNAL_COUNT) return "unknown";
+    return names[kind];
+}
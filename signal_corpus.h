@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// reproducible test waveforms for the capture benchmark. plain C with no sdk
+// headers so the same corpus can be generated on the host.
+//
+// a signal is a list of segments, each holding the level of every line for
+// duration_ns. line 0 is the one single pin formats capture, protocols put
+// their data line there. the same kind and seed always give the same segments.
+
+#define SIGNAL_LINES 3
+#define SIGNAL_FRAME_MAX 80 // segments generated at a time
+
+typedef enum {
+    SIGNAL_PWM_10, // 10 kHz pwm at 10% duty
+    SIGNAL_PWM_50,
+    SIGNAL_PWM_90,
+    SIGNAL_UART, // 115200 8n1 with random gaps, line 0 tx
+    SIGNAL_SPI, // 1 MHz mode 0 bursts, lines mosi, sck, cs
+    SIGNAL_I2C, // 100 kHz writes, lines sda, scl
+    SIGNAL_JITTER, // random edges 50 ns to 5 us apart
+    SIGNAL_IDLE, // a 1 us blip every 1 to 10 ms
+    SIGNAL_CLOCK_BURST, // 256 cycles of 8 MHz clock, then 0.1 to 1 ms idle
+    SIGNAL_COUNT,
+} signal_kind;
+
+typedef struct {
+    uint8_t levels; // bit n is line n
+    uint32_t duration_ns;
+} signal_segment;
+
+typedef struct {
+    signal_kind kind;
+    uint32_t rng;
+    uint32_t phase; // generator specific progress between frames
+    signal_segment frame[SIGNAL_FRAME_MAX];
+    uint32_t count; // segments in frame
+    uint32_t pos; // next segment to hand out
+} signal_gen;
+
+void signal_corpus_init(signal_gen *gen, signal_kind kind, uint32_t seed);
+void signal_corpus_next(signal_gen *gen, signal_segment *seg);
+const char *signal_corpus_name(signal_kind kind);
@@ -0,0 +1,245 @@
+#include "pico/stdlib.h"
+#include "hardware/structs/systick.h"
+#include <string.h>
+
+#include "stats.h"
+#include "hot_path.h"
+
+#define SYSTICK_MAX 0x00ffffff // systick is a 24 bit down counter
+
+static stats_counters counters;
+static stats_histogram irq_cycles; // cycles spent in the usb irq handler
+static stats_histogram block_latency; // microseconds from block ready to packet sent
+static stats_histogram irq_to_avail; // cycles from usb irq entry to a data buffer handed to the controller
+static stats_codec codec; // written from core1
+static stats_sched sched;
+static stats_histogram sched_latency; // cycles from an event post to its handler
+static stats_histogram sync_latency; // cycles from a forced sync edge to the sync irq reading the dma
+static stats_usb usb;
+static bool enumerating = false; // bus reset seen, set configuration not yet
+static uint32_t enum_start_us = 0;
+static uint32_t enum_setups = 0;
+static uint32_t enum_packets = 0;
+static uint32_t reset_us = 0;
+
+// systick value at usb irq entry, only valid while in_irq is set
+static uint32_t irq_entry = 0;
+static bool in_irq = false;
+static uint32_t last_irq_to_avail = 0;
+
+// time the last block got ready, only valid while block_pending is set
+static uint32_t block_ready_us = 0;
+static bool block_pending = false;
+
+// every core has its own systick, call this on each core that measures cycles
+void stats_cycles_init(void) {
+    // free running systick at the processor clock, no exception
+    systick_hw->rvr = SYSTICK_MAX;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+void stats_init(void) {
+    stats_cycles_init();
+    memset(&usb, 0, sizeof(usb));
+    stats_reset();
+}
+
+void stats_reset(void) {
+    memset(&counters, 0, sizeof(counters));
+    memset(&irq_cycles, 0, sizeof(irq_cycles));
+    memset(&block_latency, 0, sizeof(block_latency));
+    memset(&irq_to_avail, 0, sizeof(irq_to_avail));
+    memset(&codec, 0, sizeof(codec));
+    memset(&sched, 0, sizeof(sched));
+    memset(&sched_latency, 0, sizeof(sched_latency));
+    memset(&sync_latency, 0, sizeof(sync_latency));
+    reset_us = time_us_32();
+    block_pending = false;
+}
+
+static void HOT_PATH_FUNC(stats_hist_add)(stats_histogram *hist, uint32_t value) {
+    // log2 bucket, 0 goes to bucket 0
+    uint8_t bucket = (value == 0) ? 0 : (32 - __builtin_clz(value));
+    if (bucket >= STATS_HIST_BUCKETS) bucket = STATS_HIST_BUCKETS - 1;
+    hist->bucket[bucket]++;
+}
+
+static inline uint32_t HOT_PATH_FUNC(stats_cycles_since)(uint32_t start) {
+    // counter counts down so start is the bigger one unless it wrapped
+    return (start - systick_hw->cvr) & SYSTICK_MAX;
+}
+
+uint32_t HOT_PATH_FUNC(stats_cycles)(void) {
+    return systick_hw->cvr;
+}
+
+uint32_t stats_cycles_elapsed(uint32_t start) {
+    return stats_cycles_since(start);
+}
+
+// entry is the systick value read by the irq trampoline, stats_cycles()
+// here would be late by the call and by fetching this from flash
+void HOT_PATH_FUNC(stats_irq_enter)(uint32_t entry) {
+    irq_entry = entry;
+    in_irq = true;
+}
+
+void HOT_PATH_FUNC(stats_irq_exit)(void) {
+    stats_hist_add(&irq_cycles, stats_cycles_since(irq_entry));
+    in_irq = false;
+}
+
+void HOT_PATH_FUNC(stats_count_irq)(stats_irq_source source) {
+    counters.irq[source]++;
+}
+
+void HOT_PATH_FUNC(stats_count_buff_status)(stats_endpoint ep) {
+    counters.buff_status[ep]++;
+}
+
+void HOT_PATH_FUNC(stats_avail_set)(void) {
+    // only refills done from inside the usb irq say something about irq latency
+    if (!in_irq) return;
+    last_irq_to_avail = stats_cycles_since(irq_entry);
+    stats_hist_add(&irq_to_avail, last_irq_to_avail);
+}
+
+uint32_t stats_last_irq_to_avail(void) {
+    return last_irq_to_avail;
+}
+
+void stats_count_dma_block(void) {
+    counters.dma_blocks++;
+}
+
+void stats_count_fifo_stall(void) {
+    counters.fifo_stalls++;
+}
+
+void stats_add_glitches(uint32_t count) {
+    counters.glitches += count;
+}
+
+void HOT_PATH_FUNC(stats_count_data_bytes)(uint32_t bytes) {
+    counters.data_bytes += bytes;
+}
+
+uint32_t stats_data_bytes(void) {
+    return counters.data_bytes;
+}
+
+void stats_record_codec(codec_type type, uint32_t bytes_in, uint32_t bytes_out, uint32_t cycles) {
+    codec.blocks[type]++;
+    codec.bytes_in[type] += bytes_in;
+    codec.bytes_out[type] += bytes_out;
+    codec.cycles_total += cycles;
+    if (cycles > codec.cycles_max) codec.cycles_max = cycles;
+}
+
+void stats_count_codec_overrun(void) {
+    codec.budget_overruns++;
+}
+
+void stats_block_ready(void) {
+    block_ready_us = time_us_32();
+    block_pending = true;
+}
+
+void HOT_PATH_FUNC(stats_packet_sent)(void) {
+    if (!block_pending) return;
+    stats_hist_add(&block_latency, time_us_32() - block_ready_us);
+    block_pending = false;
+}
+
+void stats_sched_idle(uint32_t us) {
+    sched.idle_us += us;
+}
+
+void stats_sched_dispatch(sched_event event, uint32_t latency) {
+    sched.dispatched[event]++;
+    if (latency > sched.latency_max) sched.latency_max = latency;
+    stats_hist_add(&sched_latency, latency);
+}
+
+// called from the sync irq while the stream calibrates with start taken
+// right before forcing an edge, returns the cycles since
+uint32_t HOT_PATH_FUNC(stats_sync_latency)(uint32_t start) {
+    uint32_t latency = stats_cycles_since(start);
+    stats_hist_add(&sync_latency, latency);
+    return latency;
+}
+
+// hosts reset the bus more than once before they configure, the clock runs
+// from the first of them
+void stats_usb_bus_reset(void) {
+    if (enumerating) return;
+    enumerating = true;
+    enum_start_us = time_us_32();
+    enum_setups = 0;
+    enum_packets = 0;
+}
+
+void stats_usb_setup(void) {
+    enum_setups++;
+}
+
+void stats_usb_ep0_packet(void) {
+    enum_packets++;
+}
+
+void stats_usb_configured(void) {
+    if (!enumerating) return;
+    enumerating = false;
+    usb.enumerations++;
+    usb.enum_us = time_us_32() - enum_start_us;
+    if (usb.enum_us > usb.enum_us_max) usb.enum_us_max = usb.enum_us;
+    usb.setup_requests = enum_setups;
+    usb.ep0_packets = enum_packets;
+}
+
+const uint8_t *stats_get_page(uint16_t page, uint16_t *len) {
+    switch (page) {
+    case STATS_PAGE_COUNTERS:
+        *len = sizeof(counters);
+        return (const uint8_t *)&counters;
+    case STATS_PAGE_IRQ_CYCLES:
+        *len = sizeof(irq_cycles);
+        return (const uint8_t *)&irq_cycles;
+    case STATS_PAGE_BLOCK_LATENCY:
+        *len = sizeof(block_latency);
+        return (const uint8_t *)&block_latency;
+    case STATS_PAGE_IRQ_TO_AVAIL:
+        *len = sizeof(irq_to_avail);
+        return (const uint8_t *)&irq_to_avail;
+    case STATS_PAGE_CODEC:
+        *len = sizeof(codec);
+        return (const uint8_t *)&codec;
+    case STATS_PAGE_SCHED:
+        sched.busy_us = (time_us_32() - reset_us) - sched.idle_us;
+        *len = sizeof(sched);
+        return (const uint8_t *)&sched;
+    case STATS_PAGE_SCHED_LATENCY:
+        *len = sizeof(sched_latency);
+        return (const uint8_t *)&sched_latency;
+    case STATS_PAGE_USB:
+        *len = sizeof(usb);
+        return (const uint8_t *)&usb;
+    case STATS_PAGE_SYNC_LATENCY:
+        *len = sizeof(sync_latency);
+        return (const uint8_t *)&sync_latency;
+    default:
+        *len = 0;
+        return NULL;
+    }
+}
+
+// a page that goes out over several ep0 packets would mix counts from
+// different moments, this copy is one. irqs above the usb one can still count
+// during the copy, holding them off would add to the sync irq latency
+bool stats_copy_page(uint16_t page, stats_page *out, uint16_t *len) {
+    const uint8_t *data = stats_get_page(page, len);
+    if (data == NULL) return false;
+    memcpy(out, data, *len);
+    return true;
+}
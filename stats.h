@@ -0,0 +1,123 @@
+#pragma once
+
+#include "pico/stdlib.h"
+#include "codec.h"
+#include "sched.h"
+#include "usb_handler.h"
+
+// vendor request used to read (device->host) or reset (host->device) the stats
+#define STATS_VENDOR_ID 0x43
+
+// wValue of the read request selects which page is sent back
+#define STATS_PAGE_COUNTERS 0
+#define STATS_PAGE_IRQ_CYCLES 1
+#define STATS_PAGE_BLOCK_LATENCY 2
+#define STATS_PAGE_IRQ_TO_AVAIL 3
+#define STATS_PAGE_CODEC 4
+#define STATS_PAGE_SCHED 5
+#define STATS_PAGE_SCHED_LATENCY 6
+#define STATS_PAGE_USB 7
+#define STATS_PAGE_SYNC_LATENCY 8
+
+#define STATS_HIST_BUCKETS 16
+
+typedef enum {
+    STATS_IRQ_SETUP,
+    STATS_IRQ_BUFF_STATUS,
+    STATS_IRQ_BUS_RESET,
+    STATS_IRQ_DATA_SEQ, // data sequence errors
+    STATS_IRQ_SOURCES,
+} stats_irq_source;
+
+typedef enum {
+    STATS_EP0_IN,
+    STATS_EP0_OUT,
+    STATS_EP1_OUT,
+    STATS_EP2_IN, // data endpoint n is STATS_EP2_IN + n
+    STATS_ENDPOINTS = STATS_EP2_IN + USB_DATA_EPS,
+} stats_endpoint;
+
+// page 0, sent as is over ep0 so it has to stay packed
+typedef struct {
+    uint32_t irq[STATS_IRQ_SOURCES]; // usb irq entries per source
+    uint32_t buff_status[STATS_ENDPOINTS]; // buffer status events per endpoint
+    uint32_t dma_blocks; // completed capture dma blocks
+    uint32_t fifo_stalls; // times the pio stalled on a full rx fifo
+    uint32_t glitches; // pulses dropped by the deglitch stage
+    uint32_t data_bytes; // bytes handed to the controller on the data endpoints
+} __packed stats_counters;
+
+// page 4, compression ratio per codec is bytes_in / bytes_out
+typedef struct {
+    uint32_t blocks[CODEC_COUNT]; // blocks each codec won
+    uint32_t bytes_in[CODEC_COUNT];
+    uint32_t bytes_out[CODEC_COUNT];
+    uint32_t cycles_total; // core1 cycles spent picking and encoding
+    uint32_t cycles_max; // worst block
+    uint32_t budget_overruns; // blocks that ran out of cycles and went out with what was done, see codec_encode_block
+} __packed stats_codec;
+
+// page 5, idle share is idle_us / (idle_us + busy_us)
+typedef struct {
+    uint32_t idle_us; // time core0 spent in wfe
+    uint32_t busy_us; // the rest since the last reset
+    uint32_t dispatched[SCHED_EVENT_COUNT]; // handler runs per event
+    uint32_t latency_max; // worst cycles from post to dispatch
+} __packed stats_sched;
+
+// page 7, enumeration from the first bus reset to set configuration. the host
+// can only read it once that is over, so stats_reset leaves it alone
+typedef struct {
+    uint32_t enumerations; // set configurations after a bus reset
+    uint32_t enum_us; // first bus reset to set configuration, last enumeration
+    uint32_t enum_us_max;
+    uint32_t setup_requests; // control requests in the last enumeration
+    uint32_t ep0_packets; // ep0 in packets in the last enumeration, status stages included
+} __packed stats_usb;
+
+// pages 1 to 3, 6 and 8, bucket n counts values in [2^(n-1), 2^n), last bucket takes the rest
+typedef struct {
+    uint32_t bucket[STATS_HIST_BUCKETS];
+} __packed stats_histogram;
+
+// room for a copy of any page
+typedef union {
+    stats_counters counters;
+    stats_codec codec;
+    stats_sched sched;
+    stats_usb usb;
+    stats_histogram histogram;
+} stats_page;
+
+void stats_init(void);
+void stats_reset(void);
+
+void stats_cycles_init(void);
+uint32_t stats_cycles(void);
+uint32_t stats_cycles_elapsed(uint32_t start);
+void stats_irq_enter(uint32_t entry);
+void stats_irq_exit(void);
+void stats_count_irq(stats_irq_source source);
+void stats_count_buff_status(stats_endpoint ep);
+void stats_avail_set(void);
+uint32_t stats_last_irq_to_avail(void);
+
+void stats_count_dma_block(void);
+void stats_count_fifo_stall(void);
+void stats_add_glitches(uint32_t count);
+void stats_count_data_bytes(uint32_t bytes);
+uint32_t stats_data_bytes(void);
+void stats_record_codec(codec_type codec, uint32_t bytes_in, uint32_t bytes_out, uint32_t cycles);
+void stats_count_codec_overrun(void);
+void stats_block_ready(void);
+void stats_packet_sent(void);
+void stats_sched_idle(uint32_t us);
+void stats_sched_dispatch(sched_event event, uint32_t latency);
+uint32_t stats_sync_latency(uint32_t start);
+void stats_usb_bus_reset(void);
+void stats_usb_setup(void);
+void stats_usb_ep0_packet(void);
+void stats_usb_configured(void);
+
+const uint8_t *stats_get_page(uint16_t page, uint16_t *len);
+bool stats_copy_page(uint16_t page, stats_page *out, uint16_t *len);
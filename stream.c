@@ -0,0 +1,110 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+#include "stream.h"
+#include "usb_handler.h"
+#include "hot_path.h"
+
+#define STREAM_LANE_BITS 3 // tickets keep the lane in the low bits
+#define STREAM_LANE_MASK ((1u << STREAM_LANE_BITS) - 1)
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t len;
+} stream_segment;
+
+// queues are touched from the usb irq, everything else disables irqs around them
+typedef struct {
+    stream_segment queue[STREAM_QUEUE_LEN];
+    volatile uint32_t head; // next segment to send, also the count of finished ones
+    volatile uint32_t tail; // next free slot
+    uint32_t head_offset; // bytes of the head segment already sent
+    uint8_t next_buf; // double buffered endpoints take buffers in turn, never reset
+} stream_lane;
+
+static stream_lane lanes[USB_DATA_EPS];
+static uint8_t lane_count = 1;
+
+// fill the lane's buffers while the controller has free ones and there is data
+static void HOT_PATH_FUNC(stream_service)(uint8_t index) {
+    stream_lane *lane = &lanes[index];
+    while (lane->head != lane->tail && usb_data_ready(index, lane->next_buf)) {
+        uint8_t packet[MAX_PACKET_SIZE];
+        uint8_t len = 0;
+        while (len < MAX_PACKET_SIZE && lane->head != lane->tail) {
+            stream_segment *seg = &lane->queue[lane->head % STREAM_QUEUE_LEN];
+            uint32_t n = MIN((uint32_t)(MAX_PACKET_SIZE - len), seg->len - lane->head_offset);
+            memcpy(packet + len, seg->data + lane->head_offset, n);
+            len += n;
+            lane->head_offset += n;
+            if (lane->head_offset == seg->len) {
+                lane->head_offset = 0;
+                lane->head++;
+            }
+        }
+        usb_data_send(index, lane->next_buf, packet, len);
+        lane->next_buf ^= 1u;
+    }
+}
+
+static void HOT_PATH_FUNC(stream_ep_func)(end_point *ep, uint8_t should_handle) {
+    uint8_t index = ep->number - USB_DATA_EP_FIRST;
+    if (index < lane_count) stream_service(index);
+}
+
+// count is how many data endpoints to stripe over, 1 keeps everything on ep2
+// and 0 takes all of them
+void stream_init(uint8_t count) {
+    if (count == 0 || count > USB_DATA_EPS) count = USB_DATA_EPS;
+    lane_count = count;
+    for (uint8_t i = 0; i < USB_DATA_EPS; i++) {
+        lanes[i].head = 0;
+        lanes[i].tail = 0;
+        lanes[i].head_offset = 0;
+        // next_buf stays, the controller's buffer selector and the endpoint
+        // pid carry on from the last mode. it starts at 0 with the endpoints
+    }
+    usb_register_ep2_in_func(stream_ep_func);
+}
+
+uint8_t stream_lanes(void) {
+    return lane_count;
+}
+
+bool stream_queue(const uint8_t *data, uint32_t len, uint32_t *ticket) {
+    return stream_queue_lane(0, data, len, ticket);
+}
+
+// ticket can be passed to stream_sent to find out when data can be reused
+bool stream_queue_lane(uint8_t index, const uint8_t *data, uint32_t len, uint32_t *ticket) {
+    stream_lane *lane = &lanes[index];
+    uint32_t status = save_and_disable_interrupts();
+    if (lane->tail - lane->head >= STREAM_QUEUE_LEN) {
+        restore_interrupts(status);
+        return false;
+    }
+    lane->queue[lane->tail % STREAM_QUEUE_LEN] = (stream_segment){data, len};
+    if (ticket) *ticket = (lane->tail << STREAM_LANE_BITS) | index;
+    lane->tail++;
+    restore_interrupts(status);
+    return true;
+}
+
+bool stream_sent(uint32_t ticket) {
+    stream_lane *lane = &lanes[ticket & STREAM_LANE_MASK];
+    return (int32_t)((lane->head << STREAM_LANE_BITS) - (ticket & ~STREAM_LANE_MASK)) > 0;
+}
+
+// queue slots left on a lane, for callers that queue several segments together
+uint32_t stream_free(uint8_t index) {
+    stream_lane *lane = &lanes[index];
+    return STREAM_QUEUE_LEN - (lane->tail - lane->head);
+}
+
+// starts sending when nothing is in flight, the endpoint irqs keep it going after that
+void stream_kick(void) {
+    uint32_t status = save_and_disable_interrupts();
+    for (uint8_t i = 0; i < lane_count; i++) stream_service(i);
+    restore_interrupts(status);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "pico/stdlib.h"
+
+// queues byte ranges for the data endpoints and packs them into 64 byte
+// packets as the host reads. buffers have to stay untouched until stream_sent
+// says so.
+//
+// every data endpoint is a lane with its own queue, stream_queue uses lane 0.
+// blocks put on one lane arrive in order, across lanes the host puts capture
+// blocks back together by their stream_frame seq (stream_stripe.h).
+
+#define STREAM_QUEUE_LEN 16
+
+void stream_init(uint8_t lanes);
+uint8_t stream_lanes(void);
+bool stream_queue(const uint8_t *data, uint32_t len, uint32_t *ticket);
+bool stream_queue_lane(uint8_t lane, const uint8_t *data, uint32_t len, uint32_t *ticket);
+bool stream_sent(uint32_t ticket);
+uint32_t stream_free(uint8_t lane);
+void stream_kick(void);
@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "stream_check.h"
+#include "codec.h"
+
+#define CRC32_POLY 0xedb88320 // reflected ieee 802.3, same as zlib
+
+static uint32_t crc_table[256];
+static bool crc_table_ready = false;
+
+static void stream_crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1u) ? (c >> 1) ^ CRC32_POLY : c >> 1;
+        crc_table[i] = c;
+    }
+    crc_table_ready = true;
+}
+
+// zlib style, start with 0 and pass the result back in to continue
+uint32_t stream_crc32(uint32_t crc, const uint8_t *data, uint32_t len) {
+    if (!crc_table_ready) stream_crc_table_init();
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) crc = crc_table[(crc ^ data[i]) & 0xffu] ^ (crc >> 8);
+    return ~crc;
+}
+
+void stream_check_init(stream_checker *chk, stream_gap_func on_gap, void *ctx) {
+    if (!crc_table_ready) stream_crc_table_init();
+    chk->fill = 0;
+    chk->need = 0;
+    chk->skipping = false;
+    chk->seen_seq = false;
+    chk->fetched = false;
+    chk->next_seq = 0;
+    memset(&chk->counts, 0, sizeof(chk->counts));
+    chk->on_gap = on_gap;
+    chk->ctx = ctx;
+}
+
+static void stream_check_seq(stream_checker *chk, uint32_t seq) {
+    if (chk->fetched) return;
+    if (chk->seen_seq && seq != chk->next_seq) {
+        chk->counts.lost_blocks += (uint32_t)(seq - chk->next_seq);
+        if (chk->on_gap) chk->on_gap(chk->next_seq, seq, chk->ctx);
+    }
+    chk->seen_seq = true;
+    chk->next_seq = seq + 1;
+}
+
+static void stream_check_block(stream_checker *chk) {
+    stream_block_header header;
+    memcpy(&header, chk->block, sizeof(header));
+    if (header.type == STREAM_BLOCK_FORMAT && header.len >= sizeof(stream_format_record)) {
+        stream_format_record record;
+        memcpy(&record, chk->block + sizeof(header), sizeof(record));
+        chk->fetched = record.capture_lanes == 0;
+        // a new capture, its seqs start over
+        chk->seen_seq = false;
+        return;
+    }
+    if (header.type != STREAM_BLOCK_DATA && header.type != STREAM_BLOCK_SAMPLES) return;
+    if (header.len < sizeof(stream_frame)) {
+        chk->counts.framing_errors++;
+        chk->counts.skipped_bytes += sizeof(header) + header.len;
+        return;
+    }
+
+    stream_frame frame;
+    const uint8_t *payload = chk->block + sizeof(header) + sizeof(frame);
+    uint32_t payload_len = header.len - sizeof(frame);
+    memcpy(&frame, chk->block + sizeof(header), sizeof(frame));
+    stream_check_seq(chk, frame.seq);
+
+    const uint8_t *data = payload;
+    uint32_t len = payload_len;
+    if (header.type == STREAM_BLOCK_SAMPLES) {
+        // the device crc covers the samples before the codec touched them
+        codec_block_header codec_header;
+        if (payload_len < sizeof(codec_header) || frame.len > sizeof(chk->decoded)) {
+            chk->counts.crc_errors++;
+            return;
+        }
+        memcpy(&codec_header, payload, sizeof(codec_header));
+        if (codec_header.bytes != frame.len) {
+            chk->counts.crc_errors++;
+            return;
+        }
+        len = codec_decode_block(codec_header.codec, payload + sizeof(codec_header),
+            payload_len - sizeof(codec_header), chk->decoded, codec_header.bytes);
+        data = chk->decoded;
+    }
+    if (len != frame.len || stream_crc32(0, data, len) != frame.crc) {
+        chk->counts.crc_errors++;
+        return;
+    }
+    chk->counts.blocks++;
+    chk->counts.bytes += len;
+}
+
+static void stream_check_skip(stream_checker *chk) {
+    if (!chk->skipping) chk->counts.framing_errors++;
+    chk->skipping = true;
+    chk->counts.skipped_bytes++;
+}
+
+void stream_check_feed(stream_checker *chk, const uint8_t *data, uint32_t len) {
+    uint32_t i = 0;
+    while (i < len) {
+        if (chk->fill == 0 && data[i] != STREAM_MAGIC) {
+            // lost track of the blocks, skip to the next magic byte
+            stream_check_skip(chk);
+            i++;
+            continue;
+        }
+        if (chk->fill < sizeof(stream_block_header)) {
+            chk->block[chk->fill++] = data[i++];
+            if (chk->fill < sizeof(stream_block_header)) continue;
+            stream_block_header header;
+            memcpy(&header, chk->block, sizeof(header));
+            if (header.type > STREAM_BLOCK_PREVIEW || header.len > STREAM_CHECK_MAX_BLOCK) {
+                // a truncated header runs into the next block. only the magic
+                // byte is dropped, the next header can start in the rest
+                uint8_t rest[sizeof(header) - 1];
+                memcpy(rest, chk->block + 1, sizeof(rest));
+                chk->fill = 0;
+                stream_check_skip(chk);
+                stream_check_feed(chk, rest, sizeof(rest));
+                continue;
+            }
+            chk->skipping = false;
+            chk->need = sizeof(header) + header.len;
+        }
+        uint32_t n = chk->need - chk->fill;
+        if (n > len - i) n = len - i;
+        memcpy(chk->block + chk->fill, data + i, n);
+        chk->fill += n;
+        i += n;
+        if (chk->fill == chk->need) {
+            stream_check_block(chk);
+            chk->fill = 0;
+        }
+    }
+}
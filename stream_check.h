@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stream_format.h"
+
+// host side integrity check of the ep2 stream. plain C like rle_stream.c.
+//
+// feed it the bytes as they come off ep2, in any chunk size. every capture
+// block has its stream_frame checked: seq has to follow the last one and the
+// crc32 of the capture block has to match what the dma sniffer saw on the
+// device. lost blocks and bad crcs are counted and reported through on_gap,
+// so a bad stream shows whether the capture side or the transfer lost data.
+// losing track of the blocks counts one framing error however many bytes
+// it takes to find the next header, those bytes go to skipped_bytes.
+// after a format block with no capture lanes (preview mode) capture blocks
+// are fetch replies in whatever order the host asked, their seqs are not
+// followed and only the crc is checked.
+
+#define STREAM_CHECK_MAX_BLOCK 8192 // largest block payload accepted
+
+typedef struct {
+    uint64_t blocks; // capture blocks that passed
+    uint64_t bytes; // capture bytes in those blocks
+    uint64_t lost_blocks; // seq numbers that never showed up
+    uint64_t crc_errors; // blocks whose data does not match the device crc
+    uint64_t framing_errors; // bad block headers, runs of stray bytes and short frames
+    uint64_t skipped_bytes; // bytes dropped for those
+} stream_check_counts;
+
+// expected is the seq that should have come, seq the one that did
+typedef void (*stream_gap_func)(uint32_t expected, uint32_t seq, void *ctx);
+
+typedef struct {
+    uint8_t block[sizeof(stream_block_header) + STREAM_CHECK_MAX_BLOCK];
+    uint32_t fill; // bytes of the current block so far
+    uint32_t need; // bytes of the current block, valid once the header is in
+    bool skipping; // looking for the next header, the framing error is counted
+    bool seen_seq;
+    bool fetched; // capture blocks are fetch replies, no seq order
+    uint32_t next_seq;
+    uint8_t decoded[STREAM_CHECK_MAX_BLOCK];
+    stream_check_counts counts;
+    stream_gap_func on_gap;
+    void *ctx;
+} stream_checker;
+
+void stream_check_init(stream_checker *chk, stream_gap_func on_gap, void *ctx);
+void stream_check_feed(stream_checker *chk, const uint8_t *data, uint32_t len);
+uint32_t stream_crc32(uint32_t crc, const uint8_t *data, uint32_t len);
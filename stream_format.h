@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+// layout of the ep2 byte stream in stream mode, shared with the host side.
+// the stream is a sequence of blocks, each a stream_block_header followed by
+// len payload bytes. blocks are packed back to back across 64 byte packets.
+
+#define STREAM_MAGIC 0xa5
+
+typedef enum {
+    STREAM_BLOCK_DATA = 0, // payload is a stream_frame and raw pinpoller output
+    STREAM_BLOCK_SYNC = 1, // payload is one stream_sync_record
+    STREAM_BLOCK_SAMPLES = 2, // payload is a stream_frame, a codec_block_header and encoded multi pin samples
+    STREAM_BLOCK_FORMAT = 3, // payload is one stream_format_record, always on lane 0
+    STREAM_BLOCK_PREVIEW = 4, // payload is one preview_record (preview.h)
+} stream_block_type;
+
+typedef struct {
+    uint8_t magic; // STREAM_MAGIC
+    uint8_t type; // stream_block_type
+    uint16_t len; // payload bytes after this header
+} __attribute__((packed)) stream_block_header;
+
+// what the capture blocks that follow hold and how they are spread over the
+// data endpoints (lanes), sent before the first of them. capture_lanes 0
+// means capture blocks only go out on request (preview mode fetch replies),
+// on lane 0 in the order they were asked for with any seqs
+typedef struct {
+    uint8_t id; // capture_formats id, STREAM_FORMAT_NONE for dummy data
+    uint8_t lanes; // data endpoints in use
+    uint8_t capture_lanes; // the first capture_lanes lanes carry capture blocks striped in seq order
+} __attribute__((packed)) stream_format_record;
+
+#define STREAM_FORMAT_NONE 0xff
+
+// first thing in every capture block. crc is the standard (zlib) crc32 of the
+// capture block as the dma wrote it, for samples blocks that is after decoding
+typedef struct {
+    uint32_t seq; // capture blocks since the stream started, gaps mean lost blocks
+    uint32_t len; // capture block bytes, before encoding
+    uint32_t crc;
+    uint64_t time_us; // device time the block was complete
+} __attribute__((packed)) stream_frame;
+
+// sent when the shared sync line changes level.
+// data_offset counts capture bytes (data payload without the stream_frame)
+// since the stream started, read by the sync irq as soon as it runs. the edge
+// happened at most latency_samples samples before the end of the data at
+// data_offset, the worst irq latency the device measured when the stream
+// started, and before the pio fifo contents on top of data_offset
+// (STREAM_SYNC_SLACK bytes) were written
+typedef struct {
+    uint32_t edge; // sync edges seen since the stream started, gaps mean dropped records
+    uint8_t level; // sync line level after the edge
+    uint8_t pad;
+    uint16_t latency_samples;
+    uint64_t data_offset;
+    uint64_t time_us; // device timer, only good for coarse alignment
+} __attribute__((packed)) stream_sync_record;
+
+#define STREAM_SYNC_SLACK 20 // 4 word rx fifo and the isr
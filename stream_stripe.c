@@ -0,0 +1,146 @@
+#include <string.h>
+
+#include "stream_stripe.h"
+
+void stream_stripe_init(stream_stripe *stripe, uint8_t max_lanes, stripe_block_func on_block, void *ctx) {
+    if (max_lanes == 0 || max_lanes > STRIPE_MAX_LANES) max_lanes = STRIPE_MAX_LANES;
+    stripe->max_lanes = max_lanes;
+    stripe->lanes = 0;
+    stripe->capture_lanes = 0;
+    stripe->format_id = STREAM_FORMAT_NONE;
+    stripe->failed = false;
+    for (uint8_t i = 0; i < STRIPE_MAX_LANES; i++) stripe->lane[i].fill = 0;
+    stripe->next_seq = 0;
+    stripe->overflows = 0;
+    stripe->on_block = on_block;
+    stripe->ctx = ctx;
+}
+
+// length of the complete block at the front of the lane, 0 while it is partial.
+// bytes in front of a magic byte are junk and get dropped
+static uint32_t stripe_front(stripe_lane *lane) {
+    uint32_t skip = 0;
+    while (skip < lane->fill && lane->buf[skip] != STREAM_MAGIC) skip++;
+    if (skip) {
+        memmove(lane->buf, lane->buf + skip, lane->fill - skip);
+        lane->fill -= skip;
+    }
+    if (lane->fill < sizeof(stream_block_header)) return 0;
+    stream_block_header header;
+    memcpy(&header, lane->buf, sizeof(header));
+    uint32_t len = sizeof(header) + header.len;
+    if (len > STRIPE_LANE_BYTES) {
+        // cant ever complete, drop the magic byte and look for the next one
+        memmove(lane->buf, lane->buf + 1, lane->fill - 1);
+        lane->fill--;
+        return 0;
+    }
+    return (lane->fill >= len) ? len : 0;
+}
+
+static bool stripe_is_capture(const uint8_t *block) {
+    uint8_t type = ((const stream_block_header *)block)->type;
+    return type == STREAM_BLOCK_DATA || type == STREAM_BLOCK_SAMPLES;
+}
+
+// takes the lane count from a format block, false if the host cant follow it
+static bool stripe_format(stream_stripe *stripe, const uint8_t *block, uint32_t len) {
+    stream_format_record record;
+    if (len < sizeof(stream_block_header) + sizeof(record)) return false;
+    memcpy(&record, block + sizeof(stream_block_header), sizeof(record));
+    if (record.lanes == 0 || record.lanes > stripe->max_lanes || record.capture_lanes > record.lanes) return false;
+    // capture blocks already waiting on a lane the device does not use
+    for (uint8_t i = record.lanes; i < stripe->max_lanes; i++) {
+        if (stripe->lane[i].fill) return false;
+    }
+    stripe->lanes = record.lanes;
+    stripe->capture_lanes = record.capture_lanes;
+    stripe->format_id = record.id;
+    return true;
+}
+
+static uint32_t stripe_seq(const uint8_t *block) {
+    stream_frame frame;
+    memcpy(&frame, block + sizeof(stream_block_header), sizeof(frame));
+    return frame.seq;
+}
+
+static void stripe_pop(stream_stripe *stripe, stripe_lane *lane, uint32_t len) {
+    stripe->on_block(lane->buf, len, stripe->ctx);
+    memmove(lane->buf, lane->buf + len, lane->fill - len);
+    lane->fill -= len;
+}
+
+static void stripe_drain(stream_stripe *stripe) {
+    bool progress = true;
+    while (progress && !stripe->failed) {
+        progress = false;
+        bool all_waiting = true;
+        int oldest = -1;
+        uint32_t oldest_seq = 0;
+        // only lane 0 until the format block says how many there are
+        uint8_t lanes = stripe->lanes ? stripe->lanes : 1;
+        for (uint8_t i = 0; i < lanes; i++) {
+            stripe_lane *lane = &stripe->lane[i];
+            uint32_t len = stripe_front(lane);
+            // non capture blocks carry their own ordering, pass them straight
+            // on. so do fetch replies on lane 0, the host asked for them in
+            // that order
+            while (len && (!stripe_is_capture(lane->buf) || (i == 0 && stripe->lanes && !stripe->capture_lanes))) {
+                if (((const stream_block_header *)lane->buf)->type == STREAM_BLOCK_FORMAT) {
+                    if (!stripe_format(stripe, lane->buf, len)) {
+                        stripe->failed = true;
+                        return;
+                    }
+                    // go round again, the lanes behind lane 0 are readable now
+                    progress = true;
+                }
+                stripe_pop(stripe, lane, len);
+                len = stripe_front(lane);
+            }
+            if (!len) {
+                if (i < stripe->capture_lanes) all_waiting = false;
+                continue;
+            }
+            if (stripe->lanes && i >= stripe->capture_lanes) {
+                // a capture block on a lane the device said has none
+                stripe->failed = true;
+                return;
+            }
+            uint32_t seq = stripe_seq(lane->buf);
+            if (oldest < 0 || (int32_t)(seq - oldest_seq) < 0) {
+                oldest = i;
+                oldest_seq = seq;
+            }
+        }
+        // the next seq is here, or every lane is past it and it is lost
+        if (stripe->capture_lanes && oldest >= 0 && (oldest_seq == stripe->next_seq || all_waiting)) {
+            stripe_lane *lane = &stripe->lane[oldest];
+            stripe_pop(stripe, lane, stripe_front(lane));
+            stripe->next_seq = oldest_seq + 1;
+            progress = true;
+        }
+    }
+}
+
+bool stream_stripe_feed(stream_stripe *stripe, uint8_t index, const uint8_t *data, uint32_t len) {
+    if (len && (index >= stripe->max_lanes || (stripe->lanes && index >= stripe->lanes))) stripe->failed = true;
+    if (stripe->failed) return false;
+    stripe_lane *lane = &stripe->lane[index];
+    while (len) {
+        uint32_t n = STRIPE_LANE_BYTES - lane->fill;
+        if (n > len) n = len;
+        memcpy(lane->buf + lane->fill, data, n);
+        lane->fill += n;
+        data += n;
+        len -= n;
+        stripe_drain(stripe);
+        if (stripe->failed) return false;
+        if (len && lane->fill == STRIPE_LANE_BYTES) {
+            // the other lanes are not delivering, this one cant hold more
+            stripe->overflows += len;
+            return true;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stream_format.h"
+
+// host side reassembly of a stream striped over several data endpoints.
+// plain C like rle_stream.c.
+//
+// feed the bytes of each endpoint to its lane (lane 0 is ep2). capture blocks
+// come back out in stream_frame seq order, other blocks (sync, format) as soon
+// as they reach the front of their lane. blocks lost on the device show up as
+// a seq gap once every lane has a block waiting, stream_check counts those.
+//
+// the lane counts come from the format block on lane 0, capture blocks wait
+// until it is in. a device striping over more lanes than the host reads, or
+// data on a lane the device does not use, fails the stripe: feed returns
+// false from then on. with no capture lanes (preview mode) capture blocks are
+// fetch replies and pass straight on like the other blocks.
+
+#define STRIPE_MAX_LANES 8
+#define STRIPE_LANE_BYTES 32768 // buffered bytes per lane, a few capture blocks
+
+typedef void (*stripe_block_func)(const uint8_t *block, uint32_t len, void *ctx);
+
+typedef struct {
+    uint8_t buf[STRIPE_LANE_BYTES];
+    uint32_t fill;
+} stripe_lane;
+
+typedef struct {
+    uint8_t max_lanes; // endpoints the host reads
+    uint8_t lanes; // lanes the device uses, 0 until the format block
+    uint8_t capture_lanes; // lanes with capture blocks in seq order, 0 for fetch replies
+    uint8_t format_id; // from the format block
+    bool failed; // lane count mismatch, nothing comes out any more
+    stripe_lane lane[STRIPE_MAX_LANES];
+    uint32_t next_seq;
+    uint64_t overflows; // bytes dropped because a lane buffer was full
+    stripe_block_func on_block;
+    void *ctx;
+} stream_stripe;
+
+void stream_stripe_init(stream_stripe *stripe, uint8_t max_lanes, stripe_block_func on_block, void *ctx);
+bool stream_stripe_feed(stream_stripe *stripe, uint8_t lane, const uint8_t *data, uint32_t len);
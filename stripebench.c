@@ -0,0 +1,108 @@
+#include "pico/stdlib.h"
+#include "usb_handler.h"
+#include "stream.h"
+#include "stream_format.h"
+#include "stats.h"
+#include "sched.h"
+#include <stdio.h>
+#include <string.h>
+
+// striping benchmark, streams dummy capture blocks over 1 to USB_DATA_EPS
+// data endpoints and prints the throughput of each over uart. the host has
+// to keep a bulk read pending on every data endpoint, stream_stripe puts the
+// blocks back together. build with -DBUILD_STRIPE_BENCH=ON
+
+#define BENCH_MS 5000
+#define BENCH_BLOCK_BYTES 2048 // same as a capture half in main.c
+#define BENCH_SLOTS_PER_LANE 2
+
+typedef struct {
+    stream_block_header header;
+    stream_frame frame;
+} __packed bench_header;
+
+static uint8_t block[BENCH_BLOCK_BYTES];
+static bench_header headers[USB_DATA_EPS * BENCH_SLOTS_PER_LANE];
+static uint32_t tickets[USB_DATA_EPS * BENCH_SLOTS_PER_LANE];
+static bool queued[USB_DATA_EPS * BENCH_SLOTS_PER_LANE];
+
+static uint8_t lanes = 1;
+static bool draining = false;
+static uint32_t seq = 0;
+static uint32_t start_us = 0;
+static uint32_t start_bytes = 0;
+static uint32_t one_lane_rate = 0;
+
+static void bench_start(void) {
+    static struct {
+        stream_block_header header;
+        stream_format_record record;
+    } __packed format_block;
+
+    stream_init(lanes);
+    // stream_stripe takes the lane count of each run from here
+    format_block.header = (stream_block_header){STREAM_MAGIC, STREAM_BLOCK_FORMAT, sizeof(stream_format_record)};
+    format_block.record = (stream_format_record){STREAM_FORMAT_NONE, lanes, lanes};
+    stream_queue((uint8_t *)&format_block, sizeof(format_block), NULL);
+    memset(queued, 0, sizeof(queued));
+    seq = 0;
+    draining = false;
+    start_us = time_us_32();
+    start_bytes = stats_data_bytes();
+}
+
+// keeps every slot of every lane queued until the run is over
+static void bench_refill(void) {
+    uint8_t slots = lanes * BENCH_SLOTS_PER_LANE;
+    bool busy = false;
+    for (uint8_t i = 0; i < slots; i++) {
+        if (queued[i] && !stream_sent(tickets[i])) {
+            busy = true;
+            continue;
+        }
+        queued[i] = false;
+        if (draining) continue;
+        // slot i always carries blocks of lane i % lanes, so seq % lanes matches
+        uint8_t lane = i % lanes;
+        if (seq % lanes != lane) continue;
+        // header and payload go in together or not at all
+        if (stream_free(lane) < 2) continue;
+        headers[i].header = (stream_block_header){STREAM_MAGIC, STREAM_BLOCK_DATA, sizeof(stream_frame) + BENCH_BLOCK_BYTES};
+        headers[i].frame = (stream_frame){seq++, BENCH_BLOCK_BYTES, 0, time_us_64()};
+        stream_queue_lane(lane, (uint8_t *)&headers[i], sizeof(bench_header), NULL);
+        queued[i] = stream_queue_lane(lane, block, BENCH_BLOCK_BYTES, &tickets[i]);
+        busy = true;
+    }
+    stream_kick();
+
+    uint32_t elapsed = time_us_32() - start_us;
+    if (!draining && elapsed >= BENCH_MS * 1000) {
+        uint32_t rate = (uint32_t)(((uint64_t)(stats_data_bytes() - start_bytes) * 1000000) / elapsed);
+        if (lanes == 1) one_lane_rate = rate;
+        printf("lanes %u: %lu bytes/s, %.2fx one lane\n", lanes, rate, one_lane_rate ? (float)rate / one_lane_rate : 0.0f);
+        draining = true;
+    }
+    if (draining && !busy) {
+        lanes = (lanes % USB_DATA_EPS) + 1;
+        bench_start();
+        bench_refill();
+    }
+}
+
+static void on_configured(void) {
+    printf("stripe bench, %u data endpoints\n", USB_DATA_EPS);
+    for (uint32_t i = 0; i < BENCH_BLOCK_BYTES; i++) block[i] = i;
+    bench_start();
+    bench_refill();
+}
+
+int main() {
+    stdio_init_all();
+    stats_init();
+    sched_init();
+    sched_register(SCHED_EVENT_USB_CONFIGURED, on_configured);
+    sched_register(SCHED_EVENT_EP2_DONE, bench_refill);
+    usb_init();
+
+    sched_run();
+}
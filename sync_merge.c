@@ -0,0 +1,167 @@
+#include <string.h>
+#include <math.h>
+
+#include "sync_merge.h"
+
+// false for a counter width rle_stream does not decode
+bool sync_locator_init(sync_locator *loc, uint8_t counter_bits) {
+    if (!rle_decoder_init_width(&loc->dec, counter_bits)) return false;
+    loc->offset = 0;
+    loc->pending_count = 0;
+    return true;
+}
+
+// sync records usually show up before the data they point into has arrived
+bool sync_locator_add(sync_locator *loc, const stream_sync_record *rec) {
+    if (loc->pending_count >= SYNC_PENDING) return false;
+    sync_pending *p = &loc->pending[loc->pending_count++];
+    p->record = *rec;
+    p->started = false;
+    p->sample = 0;
+    return true;
+}
+
+// next byte offset where a pending record needs the decoder position
+static uint64_t sync_next_boundary(const sync_locator *loc) {
+    uint64_t boundary = UINT64_MAX;
+    for (uint32_t i = 0; i < loc->pending_count; i++) {
+        const sync_pending *p = &loc->pending[i];
+        uint64_t at = p->record.data_offset + (p->started ? STREAM_SYNC_SLACK : 0);
+        if (at < boundary) boundary = at;
+    }
+    return boundary;
+}
+
+// decodes data payload and resolves pending sync records on the way, runs go to on_run as usual
+uint32_t sync_locator_feed(sync_locator *loc, const uint8_t *data, uint32_t len, rle_run_func on_run, void *ctx,
+                           sync_point *out, uint32_t out_len) {
+    uint32_t found = 0;
+    while (1) {
+        // resolve everything sitting at the current offset
+        uint32_t i = 0;
+        while (i < loc->pending_count) {
+            sync_pending *p = &loc->pending[i];
+            if (!p->started && p->record.data_offset < loc->offset) {
+                // data went past before the record showed up, nothing to pin it to
+                loc->pending[i] = loc->pending[--loc->pending_count];
+                continue;
+            }
+            if (!p->started && p->record.data_offset == loc->offset) {
+                // the data up to here can be latency_samples past the edge
+                uint64_t latency = p->record.latency_samples;
+                p->started = true;
+                p->sample = loc->dec.position - ((latency < loc->dec.position) ? latency : loc->dec.position);
+            }
+            if (p->started && p->record.data_offset + STREAM_SYNC_SLACK == loc->offset) {
+                if (found < out_len) {
+                    out[found++] = (sync_point){
+                        .edge = p->record.edge,
+                        .sample = p->sample,
+                        .uncertainty = (uint32_t)(loc->dec.position - p->sample),
+                    };
+                }
+                loc->pending[i] = loc->pending[--loc->pending_count];
+                continue;
+            }
+            i++;
+        }
+        if (len == 0) break;
+        uint64_t boundary = sync_next_boundary(loc);
+        uint64_t step = (boundary > loc->offset) ? (boundary - loc->offset) : len;
+        uint32_t n = (step < len) ? (uint32_t)step : len;
+        rle_decoder_feed(&loc->dec, data, n, on_run, ctx);
+        loc->offset += n;
+        data += n;
+        len -= n;
+    }
+    return found;
+}
+
+static const sync_point *sync_find(const sync_point *points, uint32_t count, uint32_t edge) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (points[i].edge == edge) return &points[i];
+    }
+    return NULL;
+}
+
+// the middle of an edge's window, where the line is fitted through
+static double sync_middle(const sync_point *point) {
+    return (double)point->sample + (point->uncertainty / 2.0);
+}
+
+// straight line through the first and last edge both devices saw, the skew
+// bound is the worst miss over all shared edges plus both half windows on
+// the reference timeline. edges between the matched ones can be off by the
+// rounding to whole samples (a sample of each clock and half of one in
+// sync_map) once at either end of the line
+bool sync_align(const sync_point *ref, uint32_t ref_count, const sync_point *dev, uint32_t dev_count,
+                sync_alignment *align) {
+    const sync_point *first_dev = NULL, *first_ref = NULL;
+    const sync_point *last_dev = NULL, *last_ref = NULL;
+    uint32_t matched = 0;
+    for (uint32_t i = 0; i < dev_count; i++) {
+        const sync_point *r = sync_find(ref, ref_count, dev[i].edge);
+        if (r == NULL) continue;
+        matched++;
+        if (first_dev == NULL || dev[i].edge < first_dev->edge) {
+            first_dev = &dev[i];
+            first_ref = r;
+        }
+        if (last_dev == NULL || dev[i].edge > last_dev->edge) {
+            last_dev = &dev[i];
+            last_ref = r;
+        }
+    }
+    if (matched == 0) return false;
+
+    align->matched = matched;
+    align->scale = 1.0;
+    if (sync_middle(last_dev) != sync_middle(first_dev)) {
+        align->scale = (sync_middle(last_ref) - sync_middle(first_ref))
+                     / (sync_middle(last_dev) - sync_middle(first_dev));
+    }
+    align->offset = sync_middle(first_ref) - (align->scale * sync_middle(first_dev));
+
+    double worst = 0;
+    for (uint32_t i = 0; i < dev_count; i++) {
+        const sync_point *r = sync_find(ref, ref_count, dev[i].edge);
+        if (r == NULL) continue;
+        double miss = align->offset + (align->scale * sync_middle(&dev[i])) - sync_middle(r);
+        if (miss < 0) miss = -miss;
+        double bound = miss + (align->scale * dev[i].uncertainty / 2.0) + (r->uncertainty / 2.0);
+        if (bound > worst) worst = bound;
+    }
+    align->skew_bound = (uint32_t)ceil(worst + (2 * align->scale) + 3);
+    return true;
+}
+
+uint64_t sync_map(const sync_alignment *align, uint64_t sample) {
+    double mapped = align->offset + (align->scale * (double)sample);
+    return (mapped < 0) ? 0 : (uint64_t)(mapped + 0.5);
+}
+
+// k way merge of per device edge lists (device sample positions, in order)
+// onto the reference timeline
+uint32_t sync_merge_edges(const sync_edge *const edges[], const uint32_t counts[], const sync_alignment aligns[],
+                          uint8_t devices, sync_edge *out, uint32_t out_len) {
+    uint32_t next[256] = {0};
+    uint32_t written = 0;
+    while (written < out_len) {
+        int best = -1;
+        uint64_t best_sample = UINT64_MAX;
+        for (uint8_t d = 0; d < devices; d++) {
+            if (next[d] >= counts[d]) continue;
+            uint64_t sample = sync_map(&aligns[d], edges[d][next[d]].sample);
+            if (sample < best_sample) {
+                best = d;
+                best_sample = sample;
+            }
+        }
+        if (best < 0) break;
+        out[written] = edges[best][next[best]++];
+        out[written].sample = best_sample;
+        out[written].device = best;
+        written++;
+    }
+    return written;
+}
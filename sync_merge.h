@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rle_stream.h"
+#include "stream_format.h"
+
+// host side of multi device capture. plain C like rle_stream.c.
+//
+// every analyzer in a chain watches the same sync line and reports where in
+// its own data each sync edge landed (stream_sync_record). a sync_locator per
+// device turns those byte offsets into sample positions, sync_align fits one
+// device timeline onto a reference device and sync_merge_edges puts the
+// edges of all devices on the reference timeline.
+
+#define SYNC_PENDING 16
+
+typedef struct {
+    uint32_t edge; // sync edge index, the same edge has the same index on every device
+    uint64_t sample; // sample position of the edge in this device's data
+    uint32_t uncertainty; // the edge is somewhere in [sample, sample + uncertainty]
+} sync_point;
+
+typedef struct {
+    stream_sync_record record;
+    uint64_t sample; // position at data_offset less the irq latency, valid once started is set
+    bool started;
+} sync_pending;
+
+typedef struct {
+    rle_decoder dec;
+    uint64_t offset; // data bytes fed so far
+    sync_pending pending[SYNC_PENDING];
+    uint32_t pending_count;
+} sync_locator;
+
+typedef struct {
+    double scale; // reference samples per device sample
+    double offset; // reference sample of device sample 0
+    uint32_t skew_bound; // worst distance in samples between a mapped sync edge and the reference
+    uint32_t matched; // sync edges both timelines had
+} sync_alignment;
+
+typedef struct {
+    uint64_t sample; // on the reference timeline
+    uint8_t device;
+    uint8_t level; // level after the edge
+} sync_edge;
+
+bool sync_locator_init(sync_locator *loc, uint8_t counter_bits);
+bool sync_locator_add(sync_locator *loc, const stream_sync_record *rec);
+uint32_t sync_locator_feed(sync_locator *loc, const uint8_t *data, uint32_t len, rle_run_func on_run, void *ctx,
+                           sync_point *out, uint32_t out_len);
+
+bool sync_align(const sync_point *ref, uint32_t ref_count, const sync_point *dev, uint32_t dev_count,
+                sync_alignment *align);
+uint64_t sync_map(const sync_alignment *align, uint64_t sample);
+uint32_t sync_merge_edges(const sync_edge *const edges[], const uint32_t counts[], const sync_alignment aligns[],
+                          uint8_t devices, sync_edge *out, uint32_t out_len);
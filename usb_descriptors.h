@@ -18,6 +18,7 @@
 #define USB_DIR_OUT 0x0
 #define MS_REQUEST_TYPE 0xc0
 #define MS_EXT_PROP_REQUEST 0xc1
+#define VENDOR_OUT_REQUEST_TYPE 0x40
 
 #define MAX_PACKET_SIZE 64
 
@@ -2,16 +2,21 @@
 #include "pico/stdlib.h"
 #include "hardware/resets.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
 #include "hardware/regs/usb.h"
 #include "hardware/structs/usb.h"
+#include "hardware/structs/systick.h"
 #include <string.h>
 
 #include <stdio.h>
 
 #include "usb_descriptors.h"
 #include "usb_handler.h"
+#include "stats.h"
+#include "sched.h"
+#include "hot_path.h"
 
-#define EP_COUNT 2
+#define EP_COUNT (1 + USB_DATA_EPS) // ep1 out and the data endpoints
 #define INTERFACE_COUNT 1
 
 #define MANUFACTURER_STRING_INDEX 1
@@ -23,6 +28,128 @@
 
 #define usb_hw_clear ((usb_hw_t *)hw_clear_alias_untyped(usb_hw))
 
+#if USB_DATA_EPS > USB_DATA_EPS_MAX
+#error "the configuration descriptor only has room for USB_DATA_EPS_MAX data endpoints"
+#endif
+_Static_assert(USB_DATA_EPS_MAX == 8, "conf_desc lists exactly 8 data endpoint descriptors");
+
+// descriptors are put together by the compiler and sent from flash as they are
+
+static const device_descriptor dev_desc = {
+    .bLength = sizeof(device_descriptor), // size of this descriptor
+    .bDescriptorType = DEVICE_DESCRIPTOR_TYPE, // type device descriptor
+    .bcdUSB = USB_SPECIFICATION_NUMBER, // usb 2
+    .bDeviceClass = 0, // specified in interface descriptor
+    .bDeviceSubClass = 0, // no subclass
+    .bDeviceProtocol = 0, // no protocol
+    .bMaxPacketSize = MAX_PACKET_SIZE, // pico sdk says this is the maximum / this is max for bulk and control
+    .idVendor = RONALDS_VENDOR_ID, // vendor id
+    .idProduct = RONALDS_PRODUCT_ID, // product id
+    .bcdDevice = 0, // no release number
+    .iManufacturer = MANUFACTURER_STRING_INDEX, // index of string
+    .iProduct = PRODUCT_STRING_INDEX, // index of string
+    .iSerialNumber = 0, // no strings
+    .bNumConfigurations = 1, // one configuration
+};
+
+// bulk endpoint, bInterval is ignored for bulk and control endpoints
+#define ENDPOINT_DESC(address) {sizeof(endpoint_descriptor), ENDPOINT_DESCRIPTOR_TYPE, (address), BULK_TRANSFER_TYPE, MAX_PACKET_SIZE, 0}
+#define DATA_EP_DESC(i) ENDPOINT_DESC(USB_DIR_IN | (USB_DATA_EP_FIRST + (i)))
+
+// the whole configuration as the host reads it. only the first USB_DATA_EPS
+// data endpoints are part of wTotalLength, the rest is never sent
+typedef struct {
+    configuration_descriptor conf;
+    interface_descriptor intf;
+    endpoint_descriptor ep1_out;
+    endpoint_descriptor data_in[USB_DATA_EPS_MAX];
+} __packed config_blob;
+
+#define CONFIG_TOTAL_LENGTH (sizeof(config_blob) - ((USB_DATA_EPS_MAX - USB_DATA_EPS) * sizeof(endpoint_descriptor)))
+
+static const config_blob conf_desc = {
+    .conf = {
+        .bLength = sizeof(configuration_descriptor),
+        .bDescriptorType = CONFIGURATION_DESCRIPTOR_TYPE,
+        .wTotalLength = CONFIG_TOTAL_LENGTH, // everything after the device descriptor
+        .bNumInterfaces = INTERFACE_COUNT,
+        .bConfigurationValue = 1, // this is config 1
+        .iConfiguration = 0, // no strings
+        .bmAttributes = CONFIG_ATTRIBUTES, // self powered, no remote wakeup
+        .bMaxPower = MAXPOWER_100MA, // 100 mA
+    },
+    .intf = {
+        .bLength = sizeof(interface_descriptor),
+        .bDescriptorType = INTERFACE_DESCRIPTOR_TYPE,
+        .bInterfaceNumber = 0, // first and probably only one
+        .bAlternateSetting = 0,
+        .bNumEndpoints = EP_COUNT, // one for receiving commands, the rest for transmitting
+        .bInterfaceClass = VENDOR_SPECIFIC,
+        .bInterfaceSubClass = 0, // no subclass
+        .bInterfaceProtocol = 0, // no protocol
+        .iInterface = 0, // no strings
+    },
+    .ep1_out = ENDPOINT_DESC(1),
+    .data_in = {
+        DATA_EP_DESC(0), DATA_EP_DESC(1), DATA_EP_DESC(2), DATA_EP_DESC(3),
+        DATA_EP_DESC(4), DATA_EP_DESC(5), DATA_EP_DESC(6), DATA_EP_DESC(7),
+    },
+};
+
+static const language_descriptor language_desc = {
+    .bLength = sizeof(language_descriptor),
+    .bDescriptorType = STRING_DESCRIPTOR_TYPE,
+    .wLANGID0 = LANG_US,
+};
+
+// string descriptors are utf-16le, plain ascii only needs the low bytes
+static const struct {
+    string_descriptor_head head;
+    uint16_t chars[6];
+} __packed manufacturer_string = {
+    {sizeof(manufacturer_string), STRING_DESCRIPTOR_TYPE},
+    {'R', 'o', 'n', 'a', 'l', 'd'},
+};
+
+static const struct {
+    string_descriptor_head head;
+    uint16_t chars[5];
+} __packed product_string = {
+    {sizeof(product_string), STRING_DESCRIPTOR_TYPE},
+    {'L', 'o', 'g', 'i', 'c'},
+};
+
+static const ms_os_string_descriptor ms_os_string = {
+    .bLength = sizeof(ms_os_string_descriptor),
+    .bDescriptorType = STRING_DESCRIPTOR_TYPE,
+    .qwSignature = {'M', 0, 'S', 0, 'F', 0, 'T', 0, '1', 0, '0', 0, '0', 0},
+    .bMS_VendorCode = MS_OS_VENDOR_ID,
+    .bPad = 0,
+};
+
+static const winsub_descriptor winusb_desc = {
+    .dwLength = sizeof(winsub_descriptor),
+    .bcdVersion = MS_BCD_VER, // version one
+    .wIndex = MS_OS_INDEX, // from documentation
+    .bCount = 0x1, // one thing
+    .reserved = {0},
+    .bFirstInterfaceNumber = 0,
+    .reserve = 0x01, // from documentation
+    .compatibleID = {'W', 'I', 'N', 'U', 'S', 'B', 0, 0},
+    .subCompatibleID = {0},
+    .reserv = {0},
+};
+
+static const ms_extended_properties_descriptor ms_props_desc = {
+    .dwLength = sizeof(ms_extended_properties_descriptor),
+    .bcdVersion = MS_BCD_VER,
+    .wIndex = 0x5, // ?
+    .wCount = 0, // no extended properties
+};
+
+static const uint8_t config_num = 1;
+static const uint16_t device_status = DEVICE_STATUS;
+
 // global endpoints
 static end_point ep0_in = {
     .number = 0,
@@ -50,14 +177,9 @@ static end_point ep1_out = {
     .buf_ctrl = (buf_ctrl_struct *)&usb_dpram->ep_buf_ctrl[1].out,
 };
 
-static end_point ep2_in = {
-    .number = 2,
-    .pid = 0,
-    .buffer = &usb_dpram->epx_data[64], // next 64 bytes in shared buffer
-    .buffer_second = &usb_dpram->epx_data[64 * 2], // the next 64 bytes after first buffer
-    .ep_ctrl = &usb_dpram->ep_ctrl[1].in,
-    .buf_ctrl = (buf_ctrl_struct *)&usb_dpram->ep_buf_ctrl[2].in,
-};
+// double buffered bulk in endpoints from ep2 up, set up in usb_init.
+// each takes the next 128 bytes of the shared buffer after ep1
+static end_point data_in[USB_DATA_EPS];
 
 // global address
 static uint8_t device_address = 0;
@@ -67,6 +189,19 @@ static bool configured = false;
 // global end point functions
 static ep_func_ptr user_ep1_func = NULL;
 static ep2_func_ptr user_ep2_func = NULL;
+// data stage of the control in transfer going on, ep0_in_func sends the rest
+static const uint8_t *ep0_data = NULL;
+static uint16_t ep0_left = 0;
+static bool ep0_zlp = false; // a full last packet has to be followed by an empty one
+
+// what the vector table points at. always in sram whatever HOT_PATH_IN_RAM
+// says, so the entry stamp is taken before anything is fetched from flash and
+// a handler left in flash shows its xip misses in the stats. the only cycles
+// the stamp misses are the fixed exception entry, 15 on the m0+ with the
+// vector table and the stack in sram
+static void __not_in_flash_func(usb_irq_entry)(void) {
+    usb_irq_handler(systick_hw->cvr);
+}
 
 void usb_init() {
     device_address = 0;
@@ -88,16 +223,27 @@ void usb_init() {
     usb_hw->sie_ctrl = USB_SIE_CTRL_EP0_INT_1BUF_BITS | USB_SIE_CTRL_PULLUP_EN_BITS;
 
     // set the handler and enable irqs
-    irq_set_exclusive_handler(USBCTRL_IRQ, usb_irq_handler);
+    irq_set_exclusive_handler(USBCTRL_IRQ, usb_irq_entry);
     irq_set_enabled(USBCTRL_IRQ, true);
     // enable interrupts for setup request, bus reset and buff status change
     usb_hw->inte = USB_INTE_SETUP_REQ_BITS | USB_INTE_BUS_RESET_BITS | USB_INTE_BUFF_STATUS_BITS | USB_INTE_ERROR_DATA_SEQ_BITS;
 
-    // set the ep_control registers for ep1 and ep2
+    // set the ep_control registers for ep1 and the data endpoints
     usb_set_ep(&ep1_out);
-    usb_set_ep(&ep2_in);
     usb_set_ep_available(&ep1_out);
-    usb_set_ep_double_buffered(&ep2_in);
+    for (uint8_t i = 0; i < USB_DATA_EPS; i++) {
+        uint8_t number = USB_DATA_EP_FIRST + i;
+        data_in[i] = (end_point){
+            .number = number,
+            .pid = 0,
+            .buffer = &usb_dpram->epx_data[64 * (1 + (2 * i))],
+            .buffer_second = &usb_dpram->epx_data[64 * (2 + (2 * i))],
+            .ep_ctrl = &usb_dpram->ep_ctrl[number - 1].in,
+            .buf_ctrl = (buf_ctrl_struct *)&usb_dpram->ep_buf_ctrl[number].in,
+        };
+        usb_set_ep(&data_in[i]);
+        usb_set_ep_double_buffered(&data_in[i]);
+    }
 
 }
 
@@ -105,7 +251,7 @@ bool usb_is_configured(void) {
     return configured;
 }
 
-void usb_send(end_point *ep, uint8_t buf_num, uint8_t *buf, uint8_t len) {
+void HOT_PATH_FUNC(usb_send)(end_point *ep, uint8_t buf_num, uint8_t *buf, uint8_t len) {
     if (len > 64) assert(0 && "len has to be less than or equal 64");
     // copy buffer contents to dpram
     volatile uint8_t *ep_buf = ep->buffer;
@@ -128,14 +274,37 @@ void usb_send(end_point *ep, uint8_t buf_num, uint8_t *buf, uint8_t len) {
     } else {
         ep->buf_ctrl->first |= USB_BUF_CTRL_AVAIL;
     }
+    if (ep->number != 0) {
+        stats_avail_set();
+        stats_count_data_bytes(len);
+    } else {
+        stats_usb_ep0_packet();
+    }
 }
 
-void usb_ep2_send(uint8_t buf_num, uint8_t *buf, uint8_t len) {
-    usb_send(&ep2_in, buf_num, buf, len);
+// lane is the data endpoint index, lane 0 is ep2
+void HOT_PATH_FUNC(usb_data_send)(uint8_t lane, uint8_t buf_num, uint8_t *buf, uint8_t len) {
+    usb_send(&data_in[lane], buf_num, buf, len);
 }
 
+bool HOT_PATH_FUNC(usb_data_ready)(uint8_t lane, uint8_t buf_num) {
+    // the controller clears available once the buffer has been sent
+    end_point *ep = &data_in[lane];
+    uint16_t buf_ctrl = (buf_num == 1) ? ep->buf_ctrl->second : ep->buf_ctrl->first;
+    return !(buf_ctrl & USB_BUF_CTRL_AVAIL);
+}
 
-uint8_t usb_get(end_point *ep, uint8_t *buf, uint8_t max_len) {
+void HOT_PATH_FUNC(usb_ep2_send)(uint8_t buf_num, uint8_t *buf, uint8_t len) {
+    usb_data_send(0, buf_num, buf, len);
+}
+
+bool usb_ep2_ready(uint8_t buf_num) {
+    return usb_data_ready(0, buf_num);
+}
+
+// takes what the host sent without handing the buffer back, the host gets
+// naks until usb_arm
+static uint8_t HOT_PATH_FUNC(usb_read)(end_point *ep, uint8_t *buf, uint8_t max_len) {
     if (max_len > 64) assert(0 && "len has to be less than or equal 64");
     // get the length of the transfer
     uint16_t len = ep->buf_ctrl->first & USB_BUF_CTRL_LEN_MASK;
@@ -143,6 +312,11 @@ uint8_t usb_get(end_point *ep, uint8_t *buf, uint8_t max_len) {
     memcpy((void *)buf, (void *)ep->buffer, MIN(len, max_len));
     // set buf ctrl full bit to zero
     ep->buf_ctrl->first &= ~USB_BUF_CTRL_FULL;
+    return len;
+}
+
+// hands the out buffer back to the controller for the next packet
+static void HOT_PATH_FUNC(usb_arm)(end_point *ep) {
     ep->pid ^= 1u; // flip pid between 0 and 1
     if (ep->pid == 1) {
         ep->buf_ctrl->first |= USB_BUF_CTRL_DATA1_PID;
@@ -153,10 +327,35 @@ uint8_t usb_get(end_point *ep, uint8_t *buf, uint8_t max_len) {
     ep->buf_ctrl->first |= 64;
     // set available to 1 so controller can take control
     ep->buf_ctrl->first |= USB_BUF_CTRL_AVAIL;
+}
+
+uint8_t HOT_PATH_FUNC(usb_get)(end_point *ep, uint8_t *buf, uint8_t max_len) {
+    uint8_t len = usb_read(ep, buf, max_len);
+    usb_arm(ep);
     // return the size of the transfer in bytes
     return len;
 }
 
+static void usb_ep0_next(void) {
+    uint8_t len = MIN(ep0_left, MAX_PACKET_SIZE);
+    usb_send(&ep0_in, 0, (uint8_t *)ep0_data, len);
+    ep0_data += len;
+    ep0_left -= len;
+    // a short packet ends the transfer for the host
+    if (len < MAX_PACKET_SIZE) ep0_zlp = false;
+}
+
+// answers a control in request with up to max_len bytes of data, split over
+// as many packets as it takes. data has to stay put until the transfer is over
+void usb_ep0_send(const uint8_t *data, uint16_t len, uint16_t max_len) {
+    if (len > max_len) len = max_len;
+    ep0_data = data;
+    ep0_left = len;
+    // the host also stops once it has max_len bytes, no empty packet then
+    ep0_zlp = len < max_len;
+    usb_ep0_next();
+}
+
 void usb_send_ack(void) {
     usb_send(&ep0_in, 0, NULL, 0);
 }
@@ -167,14 +366,11 @@ void usb_send_stall(void) {
 }
 
 void usb_send_config_num(void) {
-    uint8_t config_num = 1;
-    usb_send(&ep0_in, 0, &config_num, 1);
+    usb_ep0_send(&config_num, sizeof(config_num), sizeof(config_num));
 }
 
 void usb_send_status(void) {
-    printf("send status\n");
-    uint16_t status = DEVICE_STATUS;
-    usb_send(&ep0_in, 0, (uint8_t *)&status, 2);
+    usb_ep0_send((const uint8_t *)&device_status, sizeof(device_status), sizeof(device_status));
 }
 
 // called when setup request irq is raised
@@ -183,6 +379,10 @@ void usb_setup_handler(void) {
     volatile usb_setup_packet *packet = (volatile usb_setup_packet *) &usb_dpram->setup_packet;
     // pid has to be 1 for sending descriptors
     ep0_in.pid = 1;
+    // a new setup packet ends whatever transfer was going on
+    ep0_left = 0;
+    ep0_zlp = false;
+    stats_usb_setup();
     // if direction is in (device->host)
     if (packet->bmRequestType == USB_DIR_IN) {
         if (packet->bRequest == REQUEST_GET_DESCRIPTOR) {
@@ -218,18 +418,28 @@ void usb_setup_handler(void) {
             usb_set_address(packet);
             break;
         case REQUEST_SET_CONFIGURATION:
-        printf("set conf\n");
             // only one configuration so just acknowledge
             usb_send_ack();
             configured = true;
+            stats_usb_configured();
+            sched_post(SCHED_EVENT_USB_CONFIGURED);
             break;
         default:
             assert(0 && "some other out request");
             break;
         }
     } else if (packet->bmRequestType == MS_REQUEST_TYPE) {
-        assert(packet->bRequest == MS_OS_VENDOR_ID);
-        usb_send_winusb_desc(packet);
+        if (packet->bRequest == STATS_VENDOR_ID) {
+            usb_send_stats(packet);
+        } else {
+            assert(packet->bRequest == MS_OS_VENDOR_ID);
+            usb_send_winusb_desc(packet);
+        }
+    } else if (packet->bmRequestType == VENDOR_OUT_REQUEST_TYPE) {
+        assert(packet->bRequest == STATS_VENDOR_ID);
+        // host wants the stats cleared
+        stats_reset();
+        usb_send_ack();
     } else if (packet->bmRequestType == MS_EXT_PROP_REQUEST) {
         usb_send_ms_props_desc(packet);
     } else {
@@ -237,57 +447,74 @@ void usb_setup_handler(void) {
     }
 }
 
-void usb_buff_status_handler(void) {
+void HOT_PATH_FUNC(usb_buff_status_handler)(void) {
     // copy the unhandled buffer flags
     uint32_t unhandled = usb_hw->buf_status;
     if (unhandled & USB_BUFF_STATUS_EP0_IN_BITS) {
         usb_hw_clear->buf_status = USB_BUFF_STATUS_EP0_IN_BITS;
+        stats_count_buff_status(STATS_EP0_IN);
         ep0_in_func();
     }
     if (unhandled & USB_BUFF_STATUS_EP0_OUT_BITS) {
         usb_hw_clear->buf_status = USB_BUFF_STATUS_EP0_OUT_BITS;
+        stats_count_buff_status(STATS_EP0_OUT);
         ep0_out_func();
     }
     if (unhandled & USB_BUFF_STATUS_EP1_OUT_BITS) {
         usb_hw_clear->buf_status = USB_BUFF_STATUS_EP1_OUT_BITS;
+        stats_count_buff_status(STATS_EP1_OUT);
         ep1_out_func();
     }
-    if (unhandled & USB_BUFF_STATUS_EP2_IN_BITS) {
-        usb_hw_clear->buf_status = USB_BUFF_STATUS_EP2_IN_BITS;
-        uint8_t should_handle = (uint8_t)(usb_hw->buf_cpu_should_handle >> 4);
-        user_ep2_func(&ep2_in, should_handle);
-        
+    bool data_done = false;
+    for (uint8_t i = 0; i < USB_DATA_EPS; i++) {
+        // in endpoint n has bit 2n in both registers
+        uint8_t shift = 2 * data_in[i].number;
+        if (!(unhandled & (1u << shift))) continue;
+        usb_hw_clear->buf_status = 1u << shift;
+        stats_count_buff_status(STATS_EP2_IN + i);
+        stats_packet_sent();
+        uint8_t should_handle = (uint8_t)((usb_hw->buf_cpu_should_handle >> shift) & 1u);
+        if (user_ep2_func != NULL) user_ep2_func(&data_in[i], should_handle);
+        data_done = true;
     }
+    if (data_done) sched_post(SCHED_EVENT_EP2_DONE);
     if (usb_hw->buf_status != 0) assert(0 && "unhandled end point");
 }
 
-void usb_irq_handler(void) {
+// entry is the systick value usb_irq_entry read first thing
+void __noinline HOT_PATH_FUNC(usb_irq_handler)(uint32_t entry) {
+    stats_irq_enter(entry);
     // copy the interrupt status register
     uint32_t interrupt_flags = usb_hw->ints;
 
     if (interrupt_flags & USB_INTS_SETUP_REQ_BITS) {
+        stats_count_irq(STATS_IRQ_SETUP);
         // got a setup request
         // remember to clear the irq flag
         usb_hw_clear->sie_status = USB_SIE_STATUS_SETUP_REC_BITS;
         usb_setup_handler();
     }
     if (interrupt_flags & USB_INTS_BUFF_STATUS_BITS) {
+        stats_count_irq(STATS_IRQ_BUFF_STATUS);
         // buffer status changed (buffer is in our control now)
         usb_buff_status_handler();
     }
     if (interrupt_flags & USB_INTS_BUS_RESET_BITS) {
+        stats_count_irq(STATS_IRQ_BUS_RESET);
         // got a bus reset request
         //clear the bus reset status from sie_status register
         usb_hw_clear->sie_status = USB_SIE_STATUS_BUS_RESET_BITS;
         usb_reset_bus();
     } if (interrupt_flags & USB_INTS_ERROR_DATA_SEQ_BITS) {
+        stats_count_irq(STATS_IRQ_DATA_SEQ);
         usb_hw_clear->sie_status = USB_SIE_STATUS_DATA_SEQ_ERROR_BITS;
         printf("data sequence error\n");
     }
+    stats_irq_exit();
 }
 
 void usb_reset_bus(void) {
-    printf("reset bus\n");
+    stats_usb_bus_reset();
     device_address = 0;
     change_address = false;
     configured = false;
@@ -298,200 +525,53 @@ void usb_reset_bus(void) {
 void usb_set_address(volatile usb_setup_packet *packet) {
     // new device address given during enumeration
     device_address = (packet->wValue & 0xff);
-    printf("set addr: %d\n", device_address);
     // address needs to be changed after acknowledging 
     change_address = true;
     usb_send_ack();
 }
 
 void usb_send_string_desc(volatile usb_setup_packet *packet) {
-    printf("send string\n");
     uint8_t index = packet->wValue & 0xff;
     if (index == 0) {
-        language_descriptor desc = {
-            .bLength = sizeof(language_descriptor),
-            .bDescriptorType = STRING_DESCRIPTOR_TYPE,
-            .wLANGID0 = LANG_US
-        };
-        usb_send(&ep0_in, 0, (uint8_t *)&desc, MIN(sizeof(language_descriptor), packet->wLength));
+        usb_ep0_send((const uint8_t *)&language_desc, sizeof(language_desc), packet->wLength);
     } else if (index == MANUFACTURER_STRING_INDEX) {
-        const char *string = "Ronald";
-        uint8_t buflen = ((2 * strlen(string)) + sizeof(string_descriptor_head));
-        string_descriptor_head head = {
-            .bLength = buflen,
-            .bDescriptorType = STRING_DESCRIPTOR_TYPE
-        };
-        uint8_t buf[64];
-        memcpy((void *)buf, (void *)&head, sizeof(head));
-        usb_make_str_to_unicode(string, buf + sizeof(head), 64 - sizeof(head));
-        usb_send(&ep0_in, 0, buf, MIN(buflen, packet->wLength));
+        usb_ep0_send((const uint8_t *)&manufacturer_string, sizeof(manufacturer_string), packet->wLength);
     } else if (index == PRODUCT_STRING_INDEX) {
-        const char *string = "Logic";
-        uint8_t buflen = ((2 * strlen(string)) + sizeof(string_descriptor_head));
-        string_descriptor_head head = {
-            .bLength = buflen,
-            .bDescriptorType = STRING_DESCRIPTOR_TYPE
-        };
-        uint8_t buf[64];
-        memcpy((void *)buf, (void *)&head, sizeof(head));
-        usb_make_str_to_unicode(string, buf + sizeof(head), 64 - sizeof(head));
-        usb_send(&ep0_in, 0, buf, MIN(buflen, packet->wLength));
+        usb_ep0_send((const uint8_t *)&product_string, sizeof(product_string), packet->wLength);
     } else if (index == WINDOWS_STRING_DESCRIPTOR_INDEX) {
-        ms_os_string_descriptor desc = usb_make_ms_os_str_desc();
-        usb_send(&ep0_in, 0, (uint8_t *)&desc, MIN(sizeof(desc), packet->wLength));
+        usb_ep0_send((const uint8_t *)&ms_os_string, sizeof(ms_os_string), packet->wLength);
     } else {
-        printf("%d : %d\n", packet->wValue, packet->wIndex);
         assert(0 && "some other index");
     }
 }
 
-void usb_make_str_to_unicode(const char *str, uint8_t *dst, uint8_t len) {
-    if (len < (2*strlen(str))) assert(0 && "destination buffer too short");
-    for (int i=0; i<strlen(str); i++) {
-        dst[(2*i)] = str[i];
-        dst[(2*i) + 1] = 0;
-    }
-}
-
-ms_os_string_descriptor usb_make_ms_os_str_desc(void) {
-    ms_os_string_descriptor desc;
-    desc.bLength = sizeof(ms_os_string_descriptor);
-    desc.bDescriptorType = STRING_DESCRIPTOR_TYPE;
-    const char *str = "MSFT100";
-    usb_make_str_to_unicode(str, desc.qwSignature, 14);
-    desc.bMS_VendorCode = MS_OS_VENDOR_ID;
-    desc.bPad = 0;
-    return desc;
-}
-
 void usb_send_winusb_desc(volatile usb_setup_packet *packet) {
-    printf("send winusb\n");
-    winsub_descriptor desc = usb_make_winusb_desc();
-    usb_send(&ep0_in, 0, (uint8_t *)&desc, MIN(sizeof(desc), packet->wLength));
+    usb_ep0_send((const uint8_t *)&winusb_desc, sizeof(winusb_desc), packet->wLength);
 }
 
 void usb_send_ms_props_desc(volatile usb_setup_packet *packet) {
-    printf("send ms props\n");
-    ms_extended_properties_descriptor desc = usb_make_ms_props_desc();
-    usb_send(&ep0_in, 0, (uint8_t *)&desc, MIN(sizeof(desc), packet->wLength));
+    usb_ep0_send((const uint8_t *)&ms_props_desc, sizeof(ms_props_desc), packet->wLength);
+}
+
+void usb_send_stats(volatile usb_setup_packet *packet) {
+    // wValue selects the page, see stats.h
+    // sent from a copy, the counters keep moving while the packets go out
+    static stats_page snapshot;
+    uint16_t len;
+    if (!stats_copy_page(packet->wValue, &snapshot, &len)) {
+        usb_send_stall();
+        return;
+    }
+    usb_ep0_send((const uint8_t *)&snapshot, len, packet->wLength);
 }
 
 void usb_send_dev_desc(volatile usb_setup_packet *packet) {
-    printf("send dev\n");
-    device_descriptor desc = usb_make_dev_desc();
-    usb_send(&ep0_in, 0, (uint8_t *)&desc, MIN(packet->wLength, sizeof(desc)));
+    usb_ep0_send((const uint8_t *)&dev_desc, sizeof(dev_desc), packet->wLength);
 }
 
 void usb_send_conf_desc(volatile usb_setup_packet *packet) {
-    printf("send conf\n");
-    configuration_descriptor desc = usb_make_conf_desc(EP_COUNT, INTERFACE_COUNT);
-    uint8_t tmp_buf[64];
-    memcpy((void *)tmp_buf, (void *)&desc, sizeof(desc));
-    uint8_t index = sizeof(desc);
-    if (packet->wLength >= desc.wTotalLength) {
-        interface_descriptor int_desc = usb_make_int_desc();
-        endpoint_descriptor end_desc1 = usb_make_end_desc(ep1_out.number, false);
-        endpoint_descriptor end_desc2 = usb_make_end_desc(ep2_in.number, true);
-        
-        memcpy((void *)(tmp_buf+index), (void *)&int_desc, sizeof(int_desc));
-        index += sizeof(int_desc);
-        memcpy((void *)(tmp_buf+index), (void *)&end_desc1, sizeof(end_desc1));
-        index += sizeof(end_desc1);
-        memcpy((void *)(tmp_buf+index), (void *)&end_desc2, sizeof(end_desc2));
-        index += sizeof(end_desc2);
-    }
-
-    usb_send(&ep0_in, 0, tmp_buf, MIN(packet->wLength, index));
-}
-
-device_descriptor usb_make_dev_desc() {
-    device_descriptor desc;
-    desc.bLength = sizeof(device_descriptor); // size of this descriptor
-    desc.bDescriptorType = DEVICE_DESCRIPTOR_TYPE; // type device descriptor
-    desc.bcdUSB = USB_SPECIFICATION_NUMBER; // usb 2
-    desc.bDeviceClass = 0; // specified in interface descriptor
-    desc.bDeviceSubClass = 0; // no subclass
-    desc.bDeviceProtocol = 0; // no protocol
-    desc.bMaxPacketSize = 64; // pico sdk says this is the maximum / this is max for bulk and control
-    desc.idVendor = RONALDS_VENDOR_ID; // vendor id
-    desc.idProduct = RONALDS_PRODUCT_ID; // product id
-    desc.bcdDevice = 0; // no release number
-    desc.iManufacturer = MANUFACTURER_STRING_INDEX; // index of string
-    desc.iProduct = PRODUCT_STRING_INDEX; // index of string
-    desc.iSerialNumber = 0; // no strings
-    desc.bNumConfigurations = 1; // one configuration
-
-    return desc;    
-}
-
-interface_descriptor usb_make_int_desc() {
-    interface_descriptor desc;
-    desc.bLength = sizeof(interface_descriptor); // length
-    desc.bDescriptorType = INTERFACE_DESCRIPTOR_TYPE; // type
-    desc.bInterfaceNumber = 0; // first and probably only one
-    desc.bAlternateSetting = 0; // this is the alternate
-    desc.bNumEndpoints = 2; // two endpoints one for receiving and one for transmitting
-    desc.bInterfaceClass = VENDOR_SPECIFIC; // vendor specific
-    desc.bInterfaceSubClass = 0; // no subclass
-    desc.bInterfaceProtocol = 0; // no protocol
-    desc.iInterface = 0; // no strings
-
-    return desc;
-}
-
-endpoint_descriptor usb_make_end_desc(uint8_t ep_num, bool in) {
-    endpoint_descriptor desc;
-    desc.bLength = sizeof(endpoint_descriptor); // size
-    desc.bDescriptorType = ENDPOINT_DESCRIPTOR_TYPE; // type
-    // shift in bit to leftmost position then or with endpoint number
-    desc.bEndpointAddress = ((in ? 1 : 0) << 7) | ep_num; // see usb_descriptors.h for details
-    desc.bmAttributes = BULK_TRANSFER_TYPE; // transfer type is bulk
-    desc.wMaxPacketSize = MAX_PACKET_SIZE; // 64 is the max packet size for bulk and control transfer
-    desc.bInterval = 0; // ignored for bulk and control endpoints
-
-    return desc;
-}
-
-configuration_descriptor usb_make_conf_desc(uint8_t ep_count, uint8_t int_count) {
-    configuration_descriptor desc;
-    desc.bLength = sizeof(configuration_descriptor); // length of configuration descriptor
-    desc.bDescriptorType = CONFIGURATION_DESCRIPTOR_TYPE; // type of descriptor 
-    desc.wTotalLength = ( // total length of the whole descriptor packet without device descriptor
-        (ep_count * sizeof(endpoint_descriptor)) // size of endpoint descriptor times number of them
-        + (int_count * sizeof(interface_descriptor)) // size of interface descriptor times number of them
-        + sizeof(configuration_descriptor));
-    desc.bNumInterfaces = int_count; // how many interfaces
-    desc.bConfigurationValue = 1; // this is config 1
-    desc.iConfiguration = 0; // no strings
-    desc.bmAttributes = CONFIG_ATTRIBUTES; // self powered, no remote wakeup
-    desc.bMaxPower = MAXPOWER_100MA; // 100 mA
-
-    return desc;
-}
-
-winsub_descriptor usb_make_winusb_desc(void) {
-    winsub_descriptor desc = {
-        .dwLength = sizeof(winsub_descriptor),
-        .bcdVersion = MS_BCD_VER, // version one
-        .wIndex = MS_OS_INDEX, // from documentation
-        .bCount = 0x1, // one thing
-        .reserved = {0},
-        .bFirstInterfaceNumber = 0,
-        .reserve = 0x01, // from documentation
-        .compatibleID = {'W', 'I', 'N', 'U', 'S', 'B', 0, 0},
-        .subCompatibleID = {0},
-        .reserv = {0}
-    };
-    return desc;
-}
-
-ms_extended_properties_descriptor usb_make_ms_props_desc(void) {
-    ms_extended_properties_descriptor desc = {
-        .dwLength = sizeof(ms_extended_properties_descriptor),
-        .bcdVersion = MS_BCD_VER,
-        .wIndex = 0x5, // ?
-        .wCount = 0 // no extended properties
-    };
+    // hosts ask for the first 9 bytes and then for wTotalLength, both come from the blob
+    usb_ep0_send((const uint8_t *)&conf_desc, CONFIG_TOTAL_LENGTH, packet->wLength);
 }
 
 void usb_set_ep(end_point *ep) {
@@ -517,6 +597,8 @@ void ep0_in_func(void) {
         // if address change was requested we change it here
         usb_hw->dev_addr_ctrl = device_address;
         change_address = false;
+    } else if (ep0_left || ep0_zlp) {
+        usb_ep0_next();
     } else {
         usb_get(&ep0_out, NULL, 0);
     }
@@ -532,11 +614,25 @@ void usb_register_ep2_in_func(ep2_func_ptr function) {
     user_ep2_func = function;
 }
 
-void ep1_out_func(void) {
+// the callback only takes a copy, the work happens in the event handler.
+// ep1 naks until that handler calls usb_ep1_out_ready, so a second
+// command can neither overwrite the copy nor fold into the same event
+void HOT_PATH_FUNC(ep1_out_func)(void) {
     uint8_t buf[64];
-    uint8_t len = usb_get(&ep1_out, buf, 64);
-    if (user_ep1_func == NULL) return;
+    uint8_t len = usb_read(&ep1_out, buf, 64);
+    if (user_ep1_func == NULL) {
+        usb_arm(&ep1_out);
+        return;
+    }
     user_ep1_func(buf, &len);
+    sched_post(SCHED_EVENT_EP1_OUT);
+}
+
+// a bus reset arms ep1 again on its own, do not flip the pid twice
+void usb_ep1_out_ready(void) {
+    uint32_t status = save_and_disable_interrupts();
+    if (!(ep1_out.buf_ctrl->first & USB_BUF_CTRL_AVAIL)) usb_arm(&ep1_out);
+    restore_interrupts(status);
 }
 
 void ep2_in_func(void) {
@@ -1,30 +1,52 @@
 #include "pico/stdio.h"
 #include "usb_handler.h"
+#include "stats.h"
+#include "sched.h"
 #include <stdio.h>
+#include <string.h>
 
+static uint8_t ep1_buf[65];
+static volatile uint8_t ep2_should_handle = 0;
+
+// both callbacks run in the usb irq, they only keep what the handlers print
 void ep1_func(uint8_t *buffer, uint8_t *len) {
-    printf("%s\n", buffer);
+    memcpy(ep1_buf, buffer, *len);
+    ep1_buf[*len] = '\0';
 }
 
 void ep2_func(end_point *ep, uint8_t should_handle) {
-    printf("yes %d\n", should_handle);
+    ep2_should_handle = should_handle;
 }
 
-int main() {
-    stdio_init_all();
-    usb_init();
+static void on_ep1(void) {
+    printf("%s\n", ep1_buf);
+    usb_ep1_out_ready();
+}
+
+static void on_ep2(void) {
+    printf("yes %d\n", ep2_should_handle);
+}
 
-    while (!usb_is_configured()) tight_loop_contents();
+static void on_configured(void) {
     printf("success\n");
 
     usb_register_ep1_out_func(ep1_func);
     usb_register_ep2_in_func(ep2_func);
 
-    uint8_t buf0[64] = {1};
-    uint8_t buf1[64] = {2};
+    static uint8_t buf0[64] = {1};
+    static uint8_t buf1[64] = {2};
     usb_ep2_send(0, buf0, 64);
     usb_ep2_send(1, buf1, 64);
+}
 
+int main() {
+    stdio_init_all();
+    stats_init();
+    sched_init();
+    sched_register(SCHED_EVENT_USB_CONFIGURED, on_configured);
+    sched_register(SCHED_EVENT_EP1_OUT, on_ep1);
+    sched_register(SCHED_EVENT_EP2_DONE, on_ep2);
+    usb_init();
 
-    while (1) tight_loop_contents();
-}
\ No newline at end of file
+    sched_run();
+}